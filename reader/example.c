@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "jascii_shm.h"
+
+static int utf8_encode(uint32_t c, char *out) {
+    if (c < 0x80) {
+        out[0] = c;
+        return 1;
+    } else if (c < 0x800) {
+        out[0] = 0xC0 | c >> 6;
+        out[1] = 0x80 | (c & 0x3F);
+        return 2;
+    } else if (c < 0x10000) {
+        out[0] = 0xE0 | c >> 12;
+        out[1] = 0x80 | (c >> 6 & 0x3F);
+        out[2] = 0x80 | (c & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | c >> 18;
+    out[1] = 0x80 | (c >> 12 & 0x3F);
+    out[2] = 0x80 | (c >> 6 & 0x3F);
+    out[3] = 0x80 | (c & 0x3F);
+    return 4;
+}
+
+// prints the live grid of a running j-ascii --shm <name> as ANSI text
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: example_reader <shm name>\n");
+        return 1;
+    }
+
+    JAsciiReader reader;
+    if (!jascii_reader_open(&reader, argv[1])) return 1;
+
+    static char out[1 << 22];
+    struct timespec wait = {0, 5 * 1000 * 1000};
+    while (1) {
+        JAsciiFrame frame;
+        if (!jascii_reader_acquire(&reader, &frame)) {
+            nanosleep(&wait, NULL);
+            continue;
+        }
+
+        // format straight from shared memory, drop the frame if it got overwritten
+        const JAsciiShmSlot *slot = frame.slot;
+        int len = sprintf(out, "\x1b[H");
+        for (uint32_t y = 0; y < frame.h && len < (int)sizeof(out) - 64 * (int)frame.w; y++) {
+            for (uint32_t x = 0; x < frame.w; x++) {
+                JAsciiShmCell c = frame.cells[y * frame.w + x];
+                uint32_t glyph = c.glyph < frame.table_len ? slot->table[c.glyph] : ' ';
+                len += sprintf(out + len, "\x1b[38;2;%d;%d;%d;48;2;%d;%d;%dm", c.r, c.g, c.b, c.bg_r, c.bg_g, c.bg_b);
+                len += utf8_encode(glyph, out + len);
+            }
+            len += sprintf(out + len, "\x1b[0m\n");
+        }
+        if (!jascii_reader_validate(&frame)) continue;
+        fwrite(out, 1, len, stdout);
+        fflush(stdout);
+    }
+
+    jascii_reader_close(&reader);
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jascii_shm.h"
+
+bool jascii_reader_open(JAsciiReader *reader, const char *name) {
+    memset(reader, 0, sizeof(*reader));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        perror("shm_open");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < JASCII_SHM_HEADER_SIZE) {
+        fprintf(stderr, "%s is not a j-ascii ring\n", name);
+        close(fd);
+        return false;
+    }
+    void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+
+    JAsciiShmHeader *header = mem;
+    if (header->magic != JASCII_SHM_MAGIC || header->version != JASCII_SHM_VERSION) {
+        fprintf(stderr, "%s has an unknown format\n", name);
+        munmap(mem, st.st_size);
+        return false;
+    }
+    // every slot has to hold max_cells and all slots have to be mapped
+    uint32_t slot_count = header->slot_count;
+    uint32_t max_cells = header->max_cells;
+    uint64_t slot_size = header->slot_size;
+    uint64_t slots_size = (uint64_t)st.st_size - JASCII_SHM_HEADER_SIZE;
+    if (slot_count == 0 || slot_size < sizeof(JAsciiShmSlot) + (uint64_t)max_cells * sizeof(JAsciiShmCell) ||
+        slot_size > slots_size / slot_count) {
+        fprintf(stderr, "%s has slots that don't fit its size\n", name);
+        munmap(mem, st.st_size);
+        return false;
+    }
+    reader->header = header;
+    reader->size = st.st_size;
+    snprintf(reader->name, sizeof(reader->name), "%s", name);
+    reader->slot_count = slot_count;
+    reader->max_cells = max_cells;
+    reader->slot_size = slot_size;
+    return true;
+}
+
+void jascii_reader_close(JAsciiReader *reader) {
+    if (reader->header) munmap(reader->header, reader->size);
+    memset(reader, 0, sizeof(*reader));
+}
+
+// j-ascii moved to a larger ring, frame numbers carry on in the new one
+static bool reopen(JAsciiReader *reader) {
+    JAsciiReader next;
+    if (!jascii_reader_open(&next, reader->name)) return false;
+    next.last_frame = reader->last_frame;
+    jascii_reader_close(reader);
+    *reader = next;
+    return true;
+}
+
+bool jascii_reader_acquire(JAsciiReader *reader, JAsciiFrame *frame) {
+    if (atomic_load_explicit(&reader->header->replaced, memory_order_acquire) && !reopen(reader)) return false;
+    JAsciiShmHeader *header = reader->header;
+    uint64_t latest = atomic_load_explicit(&header->latest, memory_order_acquire);
+    if (latest == 0 || latest == reader->last_frame) return false;
+
+    // the header's own slot geometry could have changed since open
+    const JAsciiShmSlot *slot = (const JAsciiShmSlot *)((const uint8_t *)header + JASCII_SHM_HEADER_SIZE +
+                                                        (latest % reader->slot_count) * reader->slot_size);
+    uint64_t seq = atomic_load_explicit((_Atomic uint64_t *)&slot->seq, memory_order_acquire);
+    // being rewritten, the producer already lapped us
+    if (seq & 1) return false;
+
+    frame->slot = slot;
+    frame->cells = JASCII_SHM_CELLS(slot);
+    frame->seq = seq;
+    frame->w = slot->w;
+    frame->h = slot->h;
+    frame->table_len = slot->table_len;
+    reader->last_frame = slot->frame;
+    // torn or bogus sizes would read past the slot
+    if ((uint64_t)frame->w * frame->h > reader->max_cells || frame->table_len > JASCII_SHM_TABLE_LEN) return false;
+    return jascii_reader_validate(frame);
+}
+
+bool jascii_reader_validate(const JAsciiFrame *frame) {
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t seq = atomic_load_explicit((_Atomic uint64_t *)&frame->slot->seq, memory_order_relaxed);
+    return seq == frame->seq;
+}
@@ -0,0 +1,86 @@
+#ifndef JASCII_SHM_H
+#define JASCII_SHM_H
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Shared memory layout for j-ascii --shm <name>.
+   j-ascii publishes every cell grid into a ring of slots, each slot is
+   guarded by a seqlock so readers never block the producer. A reader
+   that is too slow just sees the slot overwritten and skips ahead.
+*/
+
+#define JASCII_SHM_MAGIC 0x4353414a // "JASC"
+#define JASCII_SHM_VERSION 4
+#define JASCII_SHM_TABLE_LEN 1024
+
+typedef struct {
+    uint16_t glyph; // index into the slots table
+    uint8_t r, g, b;
+    uint8_t bg_r, bg_g, bg_b; // 0x18 gray when the cell has no background of its own
+} JAsciiShmCell;
+
+typedef struct {
+    _Atomic uint64_t seq; // odd while the producer is writing
+    uint64_t frame;
+    uint32_t w;
+    uint32_t h;
+    uint32_t table_len; // longer tables are cut, glyphs past the end are unknown
+    uint32_t table[JASCII_SHM_TABLE_LEN]; // unicode codepoints
+    // w * h JAsciiShmCell follow
+} JAsciiShmSlot;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t max_cells;
+    uint64_t slot_size;
+    _Atomic uint64_t latest; // frame number of the last complete frame, 0 if none
+    _Atomic uint32_t replaced; // set when a larger ring took over the name, reopen it
+} JAsciiShmHeader;
+
+#define JASCII_SHM_HEADER_SIZE 64
+#define JASCII_SHM_SLOT(header, i) \
+    ((JAsciiShmSlot *)((uint8_t *)(header) + JASCII_SHM_HEADER_SIZE + (i) * (header)->slot_size))
+#define JASCII_SHM_CELLS(slot) ((JAsciiShmCell *)((slot) + 1))
+
+//---Reader library---
+
+typedef struct {
+    JAsciiShmHeader *header;
+    uint64_t size;
+    uint64_t last_frame;
+    char name[256]; // to follow the ring when it is replaced
+    // copied from the header at open once they fit the mapping
+    uint32_t slot_count;
+    uint32_t max_cells;
+    uint64_t slot_size;
+} JAsciiReader;
+
+/* view into shared memory, only valid until jascii_reader_validate fails
+   or the next jascii_reader_acquire, which may map a replaced ring.
+   use w, h and table_len from here, the slot's own may change under you
+*/
+typedef struct {
+    const JAsciiShmSlot *slot;
+    const JAsciiShmCell *cells;
+    uint64_t seq;
+    uint32_t w;
+    uint32_t h; // w * h fits the slot's cell capacity
+    uint32_t table_len;
+} JAsciiFrame;
+
+bool jascii_reader_open(JAsciiReader *reader, const char *name);
+void jascii_reader_close(JAsciiReader *reader);
+
+/* get the newest frame without copying, returns false if there is no
+   frame newer than the last acquired one or its size doesn't fit a slot.
+   reading cells below w * h never leaves the mapping, but what was read
+   is only a frame once jascii_reader_validate succeeds after the reads,
+   don't act on any cell before that
+*/
+bool jascii_reader_acquire(JAsciiReader *reader, JAsciiFrame *frame);
+bool jascii_reader_validate(const JAsciiFrame *frame);
+
+#endif
@@ -0,0 +1,102 @@
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "alloc_stats.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// the size of each block is kept in front of it, keeping the alignment of malloc
+#define HEADER 16
+
+static struct {
+    bool installed;
+    SDL_malloc_func malloc;
+    SDL_calloc_func calloc;
+    SDL_realloc_func realloc;
+    SDL_free_func free;
+
+    // 64 bit so an hour long soak doesn't wrap them, SDL's atomics are 32 bit
+    atomic_ullong allocs;
+    atomic_ullong frees;
+    atomic_ullong bytes;
+    atomic_llong live_bytes;
+    atomic_llong peak_bytes;
+} alloc_state = {0};
+
+static void count_alloc(size_t size, long long live_change) {
+    atomic_fetch_add_explicit(&alloc_state.allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&alloc_state.bytes, size, memory_order_relaxed);
+    long long live = atomic_fetch_add_explicit(&alloc_state.live_bytes, live_change, memory_order_relaxed) + live_change;
+    long long peak = atomic_load_explicit(&alloc_state.peak_bytes, memory_order_relaxed);
+    while (live > peak && !atomic_compare_exchange_weak_explicit(&alloc_state.peak_bytes, &peak, live,
+                                                                 memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+static void *SDLCALL count_malloc(size_t size) {
+    size_t *block = alloc_state.malloc(size + HEADER);
+    if (block == NULL) return NULL;
+    *block = size;
+    count_alloc(size, (long long)size);
+    return (Uint8 *)block + HEADER;
+}
+
+static void *SDLCALL count_calloc(size_t count, size_t size) {
+    if (size != 0 && count > (SIZE_MAX - HEADER) / size) return NULL;
+    size_t *block = alloc_state.calloc(1, count * size + HEADER);
+    if (block == NULL) return NULL;
+    *block = count * size;
+    count_alloc(count * size, (long long)(count * size));
+    return (Uint8 *)block + HEADER;
+}
+
+static void *SDLCALL count_realloc(void *mem, size_t size) {
+    if (mem == NULL) return count_malloc(size);
+    size_t *block = (size_t *)((Uint8 *)mem - HEADER);
+    size_t old_size = *block;
+    block = alloc_state.realloc(block, size + HEADER);
+    if (block == NULL) return NULL;
+    *block = size;
+    count_alloc(size, (long long)size - (long long)old_size);
+    return (Uint8 *)block + HEADER;
+}
+
+static void SDLCALL count_free(void *mem) {
+    if (mem == NULL) return;
+    size_t *block = (size_t *)((Uint8 *)mem - HEADER);
+    atomic_fetch_add_explicit(&alloc_state.frees, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&alloc_state.live_bytes, (long long)*block, memory_order_relaxed);
+    alloc_state.free(block);
+}
+
+bool alloc_stats_install() {
+    SDL_GetOriginalMemoryFunctions(&alloc_state.malloc, &alloc_state.calloc, &alloc_state.realloc, &alloc_state.free);
+    alloc_state.installed = SDL_SetMemoryFunctions(count_malloc, count_calloc, count_realloc, count_free);
+    return alloc_state.installed;
+}
+
+bool alloc_stats_installed() { return alloc_state.installed; }
+
+AllocStats alloc_stats_get() {
+    return (AllocStats){
+        .allocs = atomic_load_explicit(&alloc_state.allocs, memory_order_relaxed),
+        .frees = atomic_load_explicit(&alloc_state.frees, memory_order_relaxed),
+        .bytes = atomic_load_explicit(&alloc_state.bytes, memory_order_relaxed),
+        .live_bytes = atomic_load_explicit(&alloc_state.live_bytes, memory_order_relaxed),
+        .peak_bytes = atomic_load_explicit(&alloc_state.peak_bytes, memory_order_relaxed),
+    };
+}
+
+size_t alloc_stats_rss() {
+#ifdef __linux__
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file == NULL) return 0;
+    unsigned long pages = 0, resident = 0;
+    int n = fscanf(file, "%lu %lu", &pages, &resident);
+    fclose(file);
+    return n == 2 ? (size_t)resident * sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
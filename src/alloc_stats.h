@@ -0,0 +1,24 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+#include <SDL3/SDL.h>
+
+/* Counts every allocation made through SDL_malloc and friends, which
+   includes SDL itself and the ascii renderer. Counters are 64 bit,
+   compare two snapshots by subtracting them.
+*/
+typedef struct {
+    Uint64 allocs; // mallocs, callocs and reallocs
+    Uint64 frees;
+    Uint64 bytes; // requested by allocs
+    Sint64 live_bytes;
+    Sint64 peak_bytes;
+} AllocStats;
+
+// has to run before anything is allocated through SDL
+bool alloc_stats_install();
+bool alloc_stats_installed();
+AllocStats alloc_stats_get();
+// resident set size in bytes, 0 where unknown
+size_t alloc_stats_rss();
+
+#endif
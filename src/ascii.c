@@ -1,121 +1,361 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <SDL3/SDL_intrin.h>
 #include <SDL3_ttf/SDL_ttf.h>
 #include "ascii.h"
 
 #define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
-#define EXIT(code) ({SDL_Quit(); exit(code);})
 
 #define GRAY(R, G, B) (0.2126f*R + 0.7152f*G + 0.0722f*B)
 
+/* hot kernels get a baseline, an x86-64-v2 and an x86-64-v3 build and the
+   loader picks one for the cpu, so a single binary is fast on every machine.
+   needs ifunc, define ASCII_NO_CLONES where the libc has none
+*/
+#if defined(__x86_64__) && defined(__ELF__) && !defined(ASCII_NO_CLONES) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define HOT_KERNEL __attribute__((target_clones("default", "arch=x86-64-v2", "arch=x86-64-v3")))
+#endif
+#endif
+#ifndef HOT_KERNEL
+#define HOT_KERNEL
+#endif
+
+#define CELL_MEASURE_SIZE 100.0f
+// font sizes kept rasterized, switching back to one of them bakes nothing
+#define ATLAS_PAGES 4
+// glyph indices are stored in 16 bits
+#define MAX_TABLE_LEN 65536
+#define DEFAULT_TABLE " .',:;xlxokXdO0KN"
+
 typedef struct {
-    char *string;
+    char *string; // utf-8
+    size_t bytes;
+    Uint32 *codepoints;
     int len;
+
+    // atlas glyph of each codepoint per atlas page, valid while generation matches the page
+    int *atlas_glyphs[ATLAS_PAGES];
+    Uint32 generation[ATLAS_PAGES];
 } Table;
 
-#define MAX_TABLE_LEN 128
-#define DEFAULT_TABLE " .',:;xlxokXdO0KN"
+#define ATLAS_WIDTH 1024
+
+// one glyph in the atlas, w is 0 for glyphs that render to nothing
+typedef struct {
+    Uint32 codepoint;
+    int x, y, w, h;
+} AtlasGlyph;
+
+/* codepoint keyed glyph atlas of the ascii font at a single size.
+   glyphs are packed in rows into an alpha plane, the renderer samples a
+   white texture made from it and ascii_raster reads the plane directly
+*/
+typedef struct {
+    float font_size; // 0 if empty
+    Uint32 generation; // unique over all pages of a context
+    Uint64 last_used;
+    int h;
+    Uint8 *alpha; // ATLAS_WIDTH x h
+    int shelf_x, shelf_y, shelf_h;
+
+    AtlasGlyph *glyphs;
+    int glyph_count;
+    int glyph_capacity;
+    // open addressing codepoint -> glyph index + 1, size is a power of two
+    int *map;
+    int map_size;
+
+    SDL_Texture *texture;
+    bool dirty;
+} GlyphAtlas;
+
+// input of a grid computed with a tile threshold
+struct AsciiTiles {
+    // what the kept pixels were computed with, anything else recomputes all
+    Uint32 context_id;
+    AsciiMode mode;
+    int table_index;
+    int w, h; // frame size
+
+    Uint8 *pixels; // frame as the cells were last computed from it, packed rows
+    size_t capacity;
+    int computed;
+    int total;
+};
 
-// global state
-TTF_TextEngine *engine;
-TTF_Font *ascii_font;
-TTF_Text *ascii_text;
-TTF_Font *ui_font;
-TTF_Text *ui_text;
+struct AsciiContext {
+    Uint32 id; // unique, tells grids apart that were computed by another context
+    bool ttf_initialized;
+    SDL_Renderer *renderer;
+    TTF_TextEngine *engine;
+    TTF_Font *ascii_font;
+    TTF_Font *ui_font;
+    TTF_Text *ui_text;
+    float cell_aspect; // width over height of a cell of the ascii font
+    float size_per_height; // font size over line height of the ascii font
 
-#define MAX_TABLES 8
-Table ascii_tables[MAX_TABLES];
-int ascii_table_count = 0;
+    Table *tables;
+    int table_count;
+    int braille_table; // after the tables read from files
+    int half_table;
+
+    // one page per recently used font size, atlas is the current one
+    GlyphAtlas pages[ATLAS_PAGES];
+    GlyphAtlas *atlas;
+    Uint32 atlas_generation;
+    Uint64 atlas_clock;
+    // draw geometry, grows with the grid
+    SDL_Vertex *vertices;
+    int *indices;
+    int geometry_capacity;
+    // tiles ascii_draw_changed redraws
+    Uint8 *dirty_tiles;
+    int dirty_capacity;
+
+    // scratch grid used by ascii_render
+    AsciiGrid render_grid;
+};
+
+/* TTF_Init and font loading share one FreeType library, serialize them.
+   opening fonts takes milliseconds, so threads sleep instead of spinning
+*/
+static SDL_InitState ttf_lock_state;
+static SDL_Mutex *ttf_lock;
+
+// created on first use and kept until exit, NULL if that failed
+static SDL_Mutex *ttf_mutex() {
+    if (SDL_ShouldInit(&ttf_lock_state)) {
+        ttf_lock = SDL_CreateMutex();
+        SDL_SetInitialized(&ttf_lock_state, ttf_lock != NULL);
+    }
+    return ttf_lock;
+}
 
 // defined in fonts.c
 SDL_IOStream *get_font_stream(char *font_name);
 
-void measure_string(char *str, int *w, int *h) {
-    TTF_MeasureString(ui_font, str, 0, 0, w, NULL);
-    *h = TTF_GetFontSize(ui_font);
+void measure_string(AsciiContext *ctx, char *str, int *w, int *h) {
+    TTF_MeasureString(ctx->ui_font, str, 0, 0, w, NULL);
+    *h = TTF_GetFontSize(ctx->ui_font);
 }
 
-void render_string(char *str, int x, int y, SDL_Color col) {
-    TTF_SetTextString(ui_text, str, 0);
-    TTF_SetTextColor(ui_text, col.r, col.g, col.b, col.a);
-    TTF_DrawRendererText(ui_text, x, y);
+void render_string(AsciiContext *ctx, char *str, int x, int y, SDL_Color col) {
+    TTF_SetTextString(ctx->ui_text, str, 0);
+    TTF_SetTextColor(ctx->ui_text, col.r, col.g, col.b, col.a);
+    TTF_DrawRendererText(ctx->ui_text, x, y);
 }
 
-void render_ascii_char(char c, int x, int y, SDL_Color col) {
-    TTF_SetTextString(ascii_text, &c, 1);
-    TTF_SetTextColor(ascii_text, col.r, col.g, col.b, col.a);
-    TTF_DrawRendererText(ascii_text, x, y);
+// setting the same size would flush the font glyph cache
+void ascii_update_font_size(AsciiContext *ctx, float size) {
+    if (TTF_GetFontSize(ctx->ascii_font) != size) TTF_SetFontSize(ctx->ascii_font, size);
 }
 
-void ascii_update_font_size(float size) {TTF_SetFontSize(ascii_font, size); }
+float ascii_cell_aspect(AsciiContext *ctx) { return ctx->cell_aspect; }
 
-void update_font_size(float size) { TTF_SetFontSize(ui_font, size); }
+float ascii_cell_font_size(AsciiContext *ctx, float cell_h) { return cell_h * ctx->size_per_height; }
 
-int ascii_get_table_count() { return ascii_table_count; }
+float ascii_grid_font_size(AsciiContext *ctx, int cols, float aspect_ratio, float height, int *rows) {
+    *rows = SDL_max(1, (int)(cols * aspect_ratio * ctx->cell_aspect));
+    return ascii_cell_font_size(ctx, height / *rows);
+}
 
-void ascii_init(SDL_Renderer *renderer, float size, char *table_file) {
-    if (!TTF_Init()) {
-        ERROR("Couldn't initialize SDL_ttf\n%s", SDL_GetError());
-        EXIT(69);
+void update_font_size(AsciiContext *ctx, float size) { TTF_SetFontSize(ctx->ui_font, size); }
+
+int ascii_get_table_count(AsciiContext *ctx) { return ctx->braille_table; }
+
+const Uint32 *ascii_get_table(AsciiContext *ctx, int table_index, int *len) {
+    SDL_assert(table_index >= 0 && table_index < ctx->table_count);
+    *len = ctx->tables[table_index].len;
+    return ctx->tables[table_index].codepoints;
+}
+
+const char *ascii_get_table_utf8(AsciiContext *ctx, int table_index, size_t *bytes) {
+    SDL_assert(table_index >= 0 && table_index < ctx->table_count);
+    *bytes = ctx->tables[table_index].bytes;
+    return ctx->tables[table_index].string;
+}
+
+// decode one utf-8 line into a new table
+static bool add_table(AsciiContext *ctx, const char *line, size_t bytes) {
+    Table table = {0};
+    table.string = SDL_malloc(bytes + 1);
+    table.codepoints = SDL_malloc(bytes * sizeof(Uint32));
+    if (table.string == NULL || table.codepoints == NULL) goto fail;
+    SDL_memcpy(table.string, line, bytes);
+    table.string[bytes] = '\0';
+    table.bytes = bytes;
+
+    const char *p = line;
+    size_t left = bytes;
+    while (left > 0) {
+        if (table.len == MAX_TABLE_LEN) {
+            ERROR("Table %d is longer than %d glyphs, truncating", ctx->table_count, MAX_TABLE_LEN);
+            table.bytes = p - line;
+            table.string[table.bytes] = '\0';
+            break;
+        }
+        // invalid sequences decode to U+FFFD
+        table.codepoints[table.len++] = SDL_StepUTF8(&p, &left);
     }
+    Table *tables = SDL_realloc(ctx->tables, (ctx->table_count + 1) * sizeof(Table));
+    if (tables == NULL) goto fail;
+    ctx->tables = tables;
+    ctx->tables[ctx->table_count++] = table;
+    return true;
+
+fail:
+    SDL_free(table.string);
+    SDL_free(table.codepoints);
+    return false;
+}
+
+// one table per line, empty lines are skipped
+static void load_tables(AsciiContext *ctx, const char *data, size_t size) {
+    const char *end = data + size;
+    while (data < end) {
+        const char *eol = memchr(data, '\n', end - data);
+        if (eol == NULL) eol = end;
+        size_t bytes = eol - data;
+        if (bytes > 0 && data[bytes - 1] == '\r') bytes--;
+        if (bytes > 0 && !add_table(ctx, data, bytes)) {
+            ERROR("Out of memory reading tables");
+            return;
+        }
+        data = eol + 1;
+    }
+}
+
+AsciiContext *ascii_create(SDL_Renderer *renderer, float size, const char *table_file) {
+    static SDL_AtomicInt next_id;
+    AsciiContext *ctx = SDL_calloc(1, sizeof(AsciiContext));
+    if (ctx == NULL) return NULL;
+    ctx->id = SDL_AddAtomicInt(&next_id, 1) + 1;
+    ctx->renderer = renderer;
+    ctx->atlas = &ctx->pages[0];
 
     // default table
-    ascii_tables[ascii_table_count++] = (Table){DEFAULT_TABLE, strlen(DEFAULT_TABLE)};
+    if (!add_table(ctx, DEFAULT_TABLE, strlen(DEFAULT_TABLE))) {
+        ascii_destroy(ctx);
+        return NULL;
+    }
 
     // read from ascii.tbl
-    FILE *file;
-    if (table_file == NULL) 
-        file = fopen("ascii.tbl", "r");
-    else 
-        file = fopen(table_file, "r");
-
-    if (file) {
-        char line[MAX_TABLE_LEN];
-        while(fgets(line, MAX_TABLE_LEN, file) != NULL) {
-            if (ascii_table_count == MAX_TABLES) break;
-            // allocate table strings
-            size_t len = strlen(line) - 1; // remove newline
-            char *string = malloc(len + 1);
-            strncpy(string, line, len);
-            string[len] = '\0';
-
-            ascii_tables[ascii_table_count++] = (Table) {
-                .string = string,
-                .len = len,
-            };
-        }
-        fclose(file);
+    size_t file_size = 0;
+    void *data = SDL_LoadFile(table_file ? table_file : "ascii.tbl", &file_size);
+    if (data) {
+        load_tables(ctx, data, file_size);
+        SDL_free(data);
     } else if (table_file) {
         ERROR("Could not open tbl file %s", table_file);
     }
 
-    engine = TTF_CreateRendererTextEngine(renderer);
+    // braille patterns in dot bit order, the font has no blank pattern so use a space
+    char braille[256 * 3];
+    char *end = braille;
+    for (Uint32 i = 0; i < 256; i++) end = SDL_UCS4ToUTF8(i ? 0x2800 + i : ' ', end);
+    ctx->braille_table = ctx->table_count;
+    ctx->half_table = ctx->table_count + 1;
+    if (!add_table(ctx, braille, end - braille) || !add_table(ctx, "\u2580", strlen("\u2580"))) {
+        ascii_destroy(ctx);
+        return NULL;
+    }
 
     // load fonts and create text objects
+    SDL_Mutex *lock = ttf_mutex();
+    if (lock == NULL) {
+        ERROR("Couldn't create font lock\n%s", SDL_GetError());
+        ascii_destroy(ctx);
+        return NULL;
+    }
+    SDL_LockMutex(lock);
+    if (!TTF_Init()) {
+        SDL_UnlockMutex(lock);
+        ERROR("Couldn't initialize SDL_ttf\n%s", SDL_GetError());
+        ascii_destroy(ctx);
+        return NULL;
+    }
+    ctx->ttf_initialized = true;
     SDL_IOStream *stream = get_font_stream("font.ttf");
     SDL_IOStream *stream2 = get_font_stream("font2.ttf");
-    ascii_font = TTF_OpenFontIO(stream, true, size);
-    ascii_text = TTF_CreateText(engine, ascii_font, "", 0);
-    ui_font = TTF_OpenFontIO(stream2, true, 32.0f);
-    ui_text = TTF_CreateText(engine, ui_font, "", 0);
+    ctx->ascii_font = TTF_OpenFontIO(stream, true, size);
+    ctx->ui_font = TTF_OpenFontIO(stream2, true, 32.0f);
+    SDL_UnlockMutex(lock);
+    if (ctx->ascii_font == NULL || ctx->ui_font == NULL) {
+        ERROR("Couldn't open fonts\n%s", SDL_GetError());
+        ascii_destroy(ctx);
+        return NULL;
+    }
+    /* glyphs are rendered advance wide and a line high, measured large so
+       the integer metrics are precise
+    */
+    int advance = 0;
+    TTF_SetFontSize(ctx->ascii_font, CELL_MEASURE_SIZE);
+    int height = TTF_GetFontHeight(ctx->ascii_font);
+    if (TTF_GetGlyphMetrics(ctx->ascii_font, 'M', NULL, NULL, NULL, NULL, &advance) && advance > 0 && height > 0) {
+        ctx->cell_aspect = (float)advance / height;
+        ctx->size_per_height = CELL_MEASURE_SIZE / height;
+    } else {
+        ctx->cell_aspect = 1.0f;
+        ctx->size_per_height = 1.0f;
+    }
+    TTF_SetFontSize(ctx->ascii_font, size);
+
+    // no renderer when running offline with ascii_raster
+    if (renderer)
+        ctx->engine = TTF_CreateRendererTextEngine(renderer);
+    ctx->ui_text = TTF_CreateText(ctx->engine, ctx->ui_font, "", 0);
+    return ctx;
 }
 
-void ascii_deinit() {
-    // free strings that were read from tbl file
-    for (int i = 1; i < ascii_table_count; i++){
-        free(ascii_tables[i].string);
+bool ascii_set_renderer(AsciiContext *ctx, SDL_Renderer *renderer) {
+    SDL_assert(ctx->engine == NULL);
+    ctx->engine = TTF_CreateRendererTextEngine(renderer);
+    if (ctx->engine == NULL) {
+        ERROR("Couldn't create text engine\n%s", SDL_GetError());
+        return false;
     }
+    ctx->renderer = renderer;
+    TTF_SetTextEngine(ctx->ui_text, ctx->engine);
+    return true;
+}
 
-    TTF_CloseFont(ascii_font);
-    TTF_DestroyText(ascii_text);
-    TTF_CloseFont(ui_font);
-    TTF_DestroyText(ui_text);
-    TTF_Quit();
+void ascii_destroy(AsciiContext *ctx) {
+    if (ctx == NULL) return;
+    for (int i = 0; i < ctx->table_count; i++) {
+        SDL_free(ctx->tables[i].string);
+        SDL_free(ctx->tables[i].codepoints);
+        for (int p = 0; p < ATLAS_PAGES; p++) SDL_free(ctx->tables[i].atlas_glyphs[p]);
+    }
+    SDL_free(ctx->tables);
+    for (int p = 0; p < ATLAS_PAGES; p++) {
+        GlyphAtlas *atlas = &ctx->pages[p];
+        SDL_free(atlas->alpha);
+        SDL_free(atlas->glyphs);
+        SDL_free(atlas->map);
+        if (atlas->texture) SDL_DestroyTexture(atlas->texture);
+    }
+    SDL_free(ctx->vertices);
+    SDL_free(ctx->indices);
+    SDL_free(ctx->dirty_tiles);
+    ascii_grid_free(&ctx->render_grid);
+
+    TTF_DestroyText(ctx->ui_text);
+    if (ctx->engine) TTF_DestroyRendererTextEngine(ctx->engine);
+    // the lock exists once ttf was initialized
+    if (ctx->ttf_initialized) {
+        SDL_LockMutex(ttf_lock);
+        TTF_CloseFont(ctx->ascii_font);
+        TTF_CloseFont(ctx->ui_font);
+        TTF_Quit();
+        SDL_UnlockMutex(ttf_lock);
+    }
+    SDL_free(ctx);
 }
 
 #define BYTES_PER_PIXEL 3
-SDL_Color get_pixel_color(SDL_Surface *img, int x, int y) {
+static SDL_Color get_pixel_color(SDL_Surface *img, int x, int y) {
     Uint8 *pixels = (Uint8 *)img->pixels;
     Uint8 *pixel = pixels + y *img->pitch + x*BYTES_PER_PIXEL;
 
@@ -128,33 +368,843 @@ SDL_Color get_pixel_color(SDL_Surface *img, int x, int y) {
     return color;
 }
 
-/*  render the given surface with the ascii renderer.
-    dst_rect specifies size of render area.
-    set table_index to 0 for default
-    format is in RGB24 since webcam formats are so sus.
-*/
-void ascii_render(SDL_Renderer *renderer, SDL_FRect *dst_rect, SDL_Surface *frame, int table_index) {
-    SDL_assert(frame->format == SDL_PIXELFORMAT_RGB24);
-    SDL_assert(table_index >= 0 && table_index < ascii_table_count);
+//---Sampling---
+
+#define SAMPLE_MAX_WIDTH 4096 // wider frames go through SDL's blit
+
+// view in source pixels, at least one pixel and inside the source
+static SDL_Rect view_rect(SDL_Surface *src, const AsciiView *view) {
+    SDL_Rect rect;
+    rect.w = SDL_clamp((int)SDL_lroundf(view->w * src->w), 1, src->w);
+    rect.h = SDL_clamp((int)SDL_lroundf(view->h * src->h), 1, src->h);
+    rect.x = SDL_clamp((int)SDL_lroundf(view->x * src->w), 0, src->w - rect.w);
+    rect.y = SDL_clamp((int)SDL_lroundf(view->y * src->h), 0, src->h - rect.h);
+    return rect;
+}
+
+static void mirror_rows(SDL_Surface *frame) {
+    for (int y = 0; y < frame->h; y++) {
+        Uint8 *l = (Uint8 *)frame->pixels + y * frame->pitch;
+        Uint8 *r = l + (frame->w - 1) * BYTES_PER_PIXEL;
+        for (; l < r; l += BYTES_PER_PIXEL, r -= BYTES_PER_PIXEL) {
+            Uint8 t[BYTES_PER_PIXEL];
+            SDL_memcpy(t, l, BYTES_PER_PIXEL);
+            SDL_memcpy(l, r, BYTES_PER_PIXEL);
+            SDL_memcpy(r, t, BYTES_PER_PIXEL);
+        }
+    }
+}
+
+bool ascii_sample(SDL_Surface *src, const AsciiView *view, SDL_Surface *dst) {
+    SDL_assert(dst->format == SDL_PIXELFORMAT_RGB24);
+    SDL_Rect rect = view_rect(src, view);
+    const SDL_PixelFormatDetails *details = SDL_GetPixelFormatDetails(src->format);
+    // yuv camera formats need SDL's conversion, only the small frame is mirrored after
+    if (SDL_ISPIXELFORMAT_FOURCC(src->format) || details == NULL || details->bits_per_pixel < 8 ||
+        dst->w > SAMPLE_MAX_WIDTH) {
+        if (!SDL_BlitSurfaceScaled(src, &rect, dst, NULL, SDL_SCALEMODE_NEAREST)) return false;
+        if (view->mirror) mirror_rows(dst);
+        return true;
+    }
+    if (!SDL_LockSurface(src)) return false;
+
+    // source offset of every column, pixel centers map to pixel centers
+    int bpp = details->bytes_per_pixel;
+    int columns[SAMPLE_MAX_WIDTH];
+    for (int x = 0; x < dst->w; x++) {
+        int col = view->mirror ? dst->w - 1 - x : x;
+        columns[x] = (rect.x + (int)((2LL * col + 1) * rect.w / (2 * dst->w))) * bpp;
+    }
+    SDL_Palette *palette = SDL_GetSurfacePalette(src);
+    for (int y = 0; y < dst->h; y++) {
+        int row = rect.y + (int)((2LL * y + 1) * rect.h / (2 * dst->h));
+        Uint8 *in = (Uint8 *)src->pixels + row * src->pitch;
+        Uint8 *out = (Uint8 *)dst->pixels + y * dst->pitch;
+        if (src->format == SDL_PIXELFORMAT_RGB24) {
+            for (int x = 0; x < dst->w; x++, out += BYTES_PER_PIXEL)
+                SDL_memcpy(out, in + columns[x], BYTES_PER_PIXEL);
+            continue;
+        }
+        for (int x = 0; x < dst->w; x++, out += BYTES_PER_PIXEL) {
+            Uint8 *p = in + columns[x];
+            Uint32 pixel;
+            switch (bpp) {
+                case 1: pixel = p[0]; break;
+                case 2: pixel = *(Uint16 *)p; break;
+                case 3: pixel = SDL_BYTEORDER == SDL_LIL_ENDIAN ? p[0] | p[1] << 8 | p[2] << 16
+                                                               : p[0] << 16 | p[1] << 8 | p[2]; break;
+                default: pixel = *(Uint32 *)p; break;
+            }
+            SDL_GetRGB(pixel, details, palette, &out[0], &out[1], &out[2]);
+        }
+    }
+    SDL_UnlockSurface(src);
+    return true;
+}
 
-    SDL_SetRenderDrawColor(renderer, 0x18, 0x18, 0x18, 0xFF);
-    SDL_RenderClear(renderer);
+bool ascii_grid_resize(AsciiGrid *grid, int w, int h) {
+    if (w * h > grid->capacity) {
+        AsciiCell *cells = SDL_realloc(grid->cells, w * h * sizeof(AsciiCell));
+        if (cells == NULL) return false;
+        grid->cells = cells;
+        grid->capacity = w * h;
+    }
+    grid->w = w;
+    grid->h = h;
+    return true;
+}
 
-    float char_size = dst_rect->h / frame->h;
-    for(int y = 0; y < frame->h; y++) { 
-        int y_pos = y * char_size;
-        for (int x = 0; x < frame->w; x++) {
-            int x_pos = x * char_size;
+void ascii_grid_free(AsciiGrid *grid) {
+    SDL_free(grid->cells);
+    if (grid->tiles) SDL_free(grid->tiles->pixels);
+    SDL_free(grid->tiles);
+    *grid = (AsciiGrid){0};
+}
 
+// the kernels compute the cells of a rect of the grid
+HOT_KERNEL static void compute_table(AsciiContext *ctx, AsciiGrid *grid, SDL_Surface *frame, int table_index, SDL_Rect r) {
+    Table current_table = ctx->tables[table_index];
+    float table_scale = (current_table.len - 1) / 255.0f;
+    for (int y = r.y; y < r.y + r.h; y++) {
+        AsciiCell *row = grid->cells + y * grid->w;
+        for (int x = r.x; x < r.x + r.w; x++) {
             SDL_Color color = get_pixel_color(frame, x, y);
 
             Uint8 gray = GRAY(color.r, color.g, color.b);
-            Table current_table = ascii_tables[table_index];
-            int index = gray * ((current_table.len - 1) / 255.0f);
-            char c = current_table.string[index];
+            row[x] = (AsciiCell){
+                .glyph = gray * table_scale,
+                .r = color.r, .g = color.g, .b = color.b,
+                .bg_r = ASCII_BACKGROUND, .bg_g = ASCII_BACKGROUND, .bg_b = ASCII_BACKGROUND,
+            };
+        }
+    }
+}
+
+void ascii_compute(AsciiContext *ctx, AsciiGrid *grid, SDL_Surface *frame, int table_index) {
+    SDL_assert(frame->format == SDL_PIXELFORMAT_RGB24);
+    SDL_assert(frame->w == grid->w && frame->h == grid->h);
+    SDL_assert(table_index >= 0 && table_index < ctx->table_count);
+
+    grid->table_index = table_index;
+    compute_table(ctx, grid, frame, table_index, (SDL_Rect){0, 0, grid->w, grid->h});
+}
+
+//---Braille---
+
+#define BRAILLE_CHUNK 64 // cells converted to luma at a time
+
+static void luma_row(Uint8 *pixels, int w, Uint8 *luma) {
+    // integer BT.709 weights summing to 256, same as GRAY
+    for (int x = 0; x < w; x++, pixels += BYTES_PER_PIXEL)
+        luma[x] = (54 * pixels[0] + 183 * pixels[1] + 19 * pixels[2]) >> 8;
+}
+
+// unicode braille dot order from per row masks, bit 2k is the left column of cell k
+static inline Uint8 braille_bits(unsigned m0, unsigned m1, unsigned m2, unsigned m3, int k) {
+    int l = 2 * k, r = 2 * k + 1;
+    return (m0 >> l & 1)      | (m1 >> l & 1) << 1 | (m2 >> l & 1) << 2 |
+           (m0 >> r & 1) << 3 | (m1 >> r & 1) << 4 | (m2 >> r & 1) << 5 |
+           (m3 >> l & 1) << 6 | (m3 >> r & 1) << 7;
+}
+
+/* dots of 8 cells from 4 rows of 16 lumas. a dot is set when brighter than
+   the average of the cell mean and mid gray, so flat areas come out solid
+   or empty and edges keep their shape. both paths round the same way
+*/
+static void braille_pack8(Uint8 *rows[4], int offset, Uint8 *dots) {
+    unsigned m[4];
+#if defined(SDL_SSE2_INTRINSICS) && defined(__SSE2__)
+    __m128i r[4];
+    for (int i = 0; i < 4; i++) r[i] = _mm_loadu_si128((const __m128i *)(rows[i] + offset));
+    __m128i col = _mm_avg_epu8(_mm_avg_epu8(r[0], r[1]), _mm_avg_epu8(r[2], r[3]));
+    __m128i low = _mm_set1_epi16(0xFF);
+    __m128i mean = _mm_avg_epu16(_mm_and_si128(col, low), _mm_srli_epi16(col, 8));
+    mean = _mm_or_si128(mean, _mm_slli_epi16(mean, 8));
+    __m128i threshold = _mm_avg_epu8(mean, _mm_set1_epi8((char)128));
+    // no unsigned byte compare in SSE2, flip the sign bits instead
+    __m128i sign = _mm_set1_epi8((char)0x80);
+    threshold = _mm_xor_si128(threshold, sign);
+    for (int i = 0; i < 4; i++)
+        m[i] = _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_xor_si128(r[i], sign), threshold));
+#else
+    Uint8 threshold[16];
+    for (int k = 0; k < 16; k += 2) {
+        int c0 = (((rows[0][offset + k] + rows[1][offset + k] + 1) >> 1) +
+                  ((rows[2][offset + k] + rows[3][offset + k] + 1) >> 1) + 1) >> 1;
+        int c1 = (((rows[0][offset + k + 1] + rows[1][offset + k + 1] + 1) >> 1) +
+                  ((rows[2][offset + k + 1] + rows[3][offset + k + 1] + 1) >> 1) + 1) >> 1;
+        int mean = (c0 + c1 + 1) >> 1;
+        threshold[k] = threshold[k + 1] = (mean + 128 + 1) >> 1;
+    }
+    for (int i = 0; i < 4; i++) {
+        m[i] = 0;
+        for (int k = 0; k < 16; k++) m[i] |= (unsigned)(rows[i][offset + k] > threshold[k]) << k;
+    }
+#endif
+    for (int k = 0; k < 8; k++) dots[k] = braille_bits(m[0], m[1], m[2], m[3], k);
+}
+
+const char *ascii_simd() {
+#if defined(SDL_SSE2_INTRINSICS) && defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+HOT_KERNEL static void compute_braille(AsciiGrid *grid, SDL_Surface *frame, SDL_Rect r) {
+    // stack scratch keeps this callable from any thread
+    Uint8 luma[4][BRAILLE_CHUNK * 2];
+    Uint8 *rows[4] = {luma[0], luma[1], luma[2], luma[3]};
+    Uint8 dots[BRAILLE_CHUNK];
+    for (int y = r.y; y < r.y + r.h; y++) {
+        Uint8 *src[4];
+        for (int i = 0; i < 4; i++) src[i] = (Uint8 *)frame->pixels + (y * 4 + i) * frame->pitch;
+        AsciiCell *row = grid->cells + y * grid->w;
+
+        for (int x0 = r.x; x0 < r.x + r.w; x0 += BRAILLE_CHUNK) {
+            int n = SDL_min(BRAILLE_CHUNK, r.x + r.w - x0);
+            for (int i = 0; i < 4; i++) {
+                luma_row(src[i] + x0 * 2 * BYTES_PER_PIXEL, n * 2, luma[i]);
+                SDL_memset(luma[i] + n * 2, 0, sizeof(luma[i]) - n * 2);
+            }
+            for (int k = 0; k < n; k += 8) braille_pack8(rows, k * 2, dots + k);
+
+            // color is the average of the 8 pixels
+            for (int k = 0; k < n; k++) {
+                int r = 0, g = 0, b = 0;
+                for (int i = 0; i < 4; i++) {
+                    Uint8 *p = src[i] + (x0 + k) * 2 * BYTES_PER_PIXEL;
+                    r += p[0] + p[3];
+                    g += p[1] + p[4];
+                    b += p[2] + p[5];
+                }
+                row[x0 + k] = (AsciiCell){
+                    .glyph = dots[k],
+                    .r = r >> 3, .g = g >> 3, .b = b >> 3,
+                    .bg_r = ASCII_BACKGROUND, .bg_g = ASCII_BACKGROUND, .bg_b = ASCII_BACKGROUND,
+                };
+            }
+        }
+    }
+}
+
+//---Half blocks---
+
+HOT_KERNEL static void compute_half(AsciiGrid *grid, SDL_Surface *frame, SDL_Rect r) {
+    for (int y = r.y; y < r.y + r.h; y++) {
+        Uint8 *top = (Uint8 *)frame->pixels + y * 2 * frame->pitch + r.x * BYTES_PER_PIXEL;
+        Uint8 *bottom = top + frame->pitch;
+        AsciiCell *row = grid->cells + y * grid->w;
+        for (int x = r.x; x < r.x + r.w; x++, top += BYTES_PER_PIXEL, bottom += BYTES_PER_PIXEL) {
+            row[x] = (AsciiCell){
+                .glyph = 0,
+                .r = top[0], .g = top[1], .b = top[2],
+                .bg_r = bottom[0], .bg_g = bottom[1], .bg_b = bottom[2],
+            };
+        }
+    }
+}
+
+//---Modes---
+
+void ascii_mode_scale(AsciiMode mode, int *sx, int *sy) {
+    *sx = mode == ASCII_MODE_BRAILLE ? 2 : 1;
+    *sy = mode == ASCII_MODE_BRAILLE ? 4 : mode == ASCII_MODE_HALF ? 2 : 1;
+}
+
+const char *ascii_mode_name(AsciiMode mode) {
+    switch (mode) {
+        case ASCII_MODE_BRAILLE: return "braille";
+        case ASCII_MODE_HALF: return "half";
+        default: return "table";
+    }
+}
+
+int ascii_mode_table(AsciiContext *ctx, AsciiMode mode, int table_index) {
+    switch (mode) {
+        case ASCII_MODE_BRAILLE: return ctx->braille_table;
+        case ASCII_MODE_HALF: return ctx->half_table;
+        default: return table_index;
+    }
+}
+
+static void compute_rect(AsciiContext *ctx, AsciiMode mode, AsciiGrid *grid, SDL_Surface *frame, int table_index, SDL_Rect r) {
+    switch (mode) {
+        case ASCII_MODE_BRAILLE: compute_braille(grid, frame, r); break;
+        case ASCII_MODE_HALF: compute_half(grid, frame, r); break;
+        default: compute_table(ctx, grid, frame, table_index, r); break;
+    }
+}
+
+//---Tiles---
+
+#define TILE_CELLS 8 // tiles are blocks of 8x8 cells
+
+// true if no byte of a block moved more than threshold
+static bool block_same(const Uint8 *a, int a_pitch, const Uint8 *b, int b_pitch, int bytes, int rows, int threshold) {
+    threshold = SDL_min(threshold, 255);
+    for (int y = 0; y < rows; y++, a += a_pitch, b += b_pitch) {
+        int i = 0, moved = 0;
+#if defined(SDL_SSE2_INTRINSICS) && defined(__SSE2__)
+        // |a - b| from two saturating subtractions, anything left above the threshold moved
+        __m128i t = _mm_set1_epi8((char)threshold);
+        __m128i over = _mm_setzero_si128();
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+            __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            over = _mm_or_si128(over, _mm_subs_epu8(diff, t));
+        }
+        moved = _mm_movemask_epi8(_mm_cmpeq_epi8(over, _mm_setzero_si128())) != 0xFFFF;
+#endif
+        for (; i < bytes; i++) {
+            int d = a[i] - b[i];
+            moved |= (d > threshold) | (d < -threshold);
+        }
+        if (moved) return false;
+    }
+    return true;
+}
+
+static void block_copy(Uint8 *dst, int dst_pitch, const Uint8 *src, int src_pitch, int bytes, int rows) {
+    for (int y = 0; y < rows; y++, dst += dst_pitch, src += src_pitch) SDL_memcpy(dst, src, bytes);
+}
+
+/* compares every tile with the pixels its cells were last computed from and
+   recomputes runs of changed tiles. unchanged tiles keep their old pixels, so
+   slow drift still adds up past the threshold. false if it can't keep state
+*/
+static bool compute_tiles(AsciiContext *ctx, AsciiMode mode, AsciiGrid *grid, SDL_Surface *frame, int table_index) {
+    AsciiTiles *t = grid->tiles;
+    if (t == NULL) t = grid->tiles = SDL_calloc(1, sizeof(AsciiTiles));
+    if (t == NULL) return false;
+    int pitch = frame->w * BYTES_PER_PIXEL;
+    size_t size = (size_t)pitch * frame->h;
+    if (size > t->capacity) {
+        Uint8 *pixels = SDL_realloc(t->pixels, size);
+        if (pixels == NULL) return false;
+        t->pixels = pixels;
+        t->capacity = size;
+        t->w = 0;
+    }
+    bool all = t->context_id != ctx->id || t->mode != mode || t->table_index != grid->table_index ||
+               t->w != frame->w || t->h != frame->h;
+    if (all) {
+        block_copy(t->pixels, pitch, frame->pixels, frame->pitch, pitch, frame->h);
+        compute_rect(ctx, mode, grid, frame, table_index, (SDL_Rect){0, 0, grid->w, grid->h});
+        t->context_id = ctx->id;
+        t->mode = mode;
+        t->table_index = grid->table_index;
+        t->w = frame->w;
+        t->h = frame->h;
+        t->computed = t->total = ((grid->w + TILE_CELLS - 1) / TILE_CELLS) * ((grid->h + TILE_CELLS - 1) / TILE_CELLS);
+        return true;
+    }
+
+    int sx, sy;
+    ascii_mode_scale(mode, &sx, &sy);
+    int tile_bytes = TILE_CELLS * sx * BYTES_PER_PIXEL;
+    t->computed = t->total = 0;
+    for (int y = 0; y < grid->h; y += TILE_CELLS) {
+        int rows = SDL_min(TILE_CELLS, grid->h - y);
+        Uint8 *src = (Uint8 *)frame->pixels + y * sy * frame->pitch;
+        Uint8 *kept = t->pixels + y * sy * pitch;
+        int run = -1; // first cell of the changed tiles being collected
+        for (int x = 0; x < grid->w + TILE_CELLS; x += TILE_CELLS) {
+            bool changed = false;
+            if (x < grid->w) {
+                int bytes = SDL_min(tile_bytes, pitch - x * sx * BYTES_PER_PIXEL);
+                int offset = x * sx * BYTES_PER_PIXEL;
+                changed = !block_same(src + offset, frame->pitch, kept + offset, pitch, bytes, rows * sy, grid->tile_threshold);
+                if (changed) block_copy(kept + offset, pitch, src + offset, frame->pitch, bytes, rows * sy);
+                t->total++;
+                t->computed += changed;
+            }
+            if (changed && run < 0) run = x;
+            if (!changed && run >= 0) {
+                compute_rect(ctx, mode, grid, frame, table_index, (SDL_Rect){run, y, SDL_min(x, grid->w) - run, rows});
+                run = -1;
+            }
+        }
+    }
+    return true;
+}
+
+void ascii_tile_stats(AsciiGrid *grid, int *computed, int *total) {
+    *computed = grid->tiles ? grid->tiles->computed : 0;
+    *total = grid->tiles ? grid->tiles->total : 0;
+}
+
+void ascii_compute_mode(AsciiContext *ctx, AsciiMode mode, AsciiGrid *grid, SDL_Surface *frame, int table_index) {
+    SDL_assert(frame->format == SDL_PIXELFORMAT_RGB24);
+    int sx, sy;
+    ascii_mode_scale(mode, &sx, &sy);
+    SDL_assert(frame->w == grid->w * sx && frame->h == grid->h * sy);
+    SDL_assert(mode != ASCII_MODE_TABLE || (table_index >= 0 && table_index < ctx->table_count));
+
+    grid->table_index = ascii_mode_table(ctx, mode, table_index);
+    // half block cells are copies of their pixels, comparing them costs more than that
+    if (grid->tile_threshold > 0 && mode != ASCII_MODE_HALF && compute_tiles(ctx, mode, grid, frame, table_index))
+        return;
+    compute_rect(ctx, mode, grid, frame, table_index, (SDL_Rect){0, 0, grid->w, grid->h});
+    // the kept pixels no longer match the cells, the next tiled compute does all of them
+    if (grid->tiles) grid->tiles->w = 0;
+}
+
+//---Glyph atlas---
+
+static void atlas_reset(AsciiContext *ctx, GlyphAtlas *atlas, float font_size) {
+    atlas->font_size = font_size;
+    atlas->generation = ++ctx->atlas_generation;
+    atlas->glyph_count = 0;
+    atlas->shelf_x = atlas->shelf_y = atlas->shelf_h = 0;
+    if (atlas->alpha) SDL_memset(atlas->alpha, 0, ATLAS_WIDTH * atlas->h);
+    if (atlas->map) SDL_memset(atlas->map, 0, atlas->map_size * sizeof(int));
+    atlas->dirty = true;
+}
+
+static int *atlas_slot(GlyphAtlas *atlas, Uint32 codepoint) {
+    Uint32 mask = atlas->map_size - 1;
+    Uint32 i = (codepoint * 2654435761u) & mask;
+    while (atlas->map[i] && atlas->glyphs[atlas->map[i] - 1].codepoint != codepoint)
+        i = (i + 1) & mask;
+    return &atlas->map[i];
+}
+
+// keeps the map at most half full
+static bool atlas_grow_map(GlyphAtlas *atlas) {
+    if ((atlas->glyph_count + 1) * 2 <= atlas->map_size) return true;
+    int size = atlas->map_size ? atlas->map_size * 2 : 256;
+    int *map = SDL_calloc(size, sizeof(int));
+    if (map == NULL) return false;
+    SDL_free(atlas->map);
+    atlas->map = map;
+    atlas->map_size = size;
+    for (int i = 0; i < atlas->glyph_count; i++)
+        *atlas_slot(atlas, atlas->glyphs[i].codepoint) = i + 1;
+    return true;
+}
+
+// reserve a w x h area in the atlas
+static bool atlas_pack(GlyphAtlas *atlas, int w, int h, int *x, int *y) {
+    if (atlas->shelf_x + w > ATLAS_WIDTH) {
+        atlas->shelf_y += atlas->shelf_h;
+        atlas->shelf_x = 0;
+        atlas->shelf_h = 0;
+    }
+    if (atlas->shelf_y + h > atlas->h) {
+        int new_h = SDL_max(atlas->h * 2, atlas->shelf_y + h);
+        Uint8 *alpha = SDL_realloc(atlas->alpha, ATLAS_WIDTH * new_h);
+        if (alpha == NULL) return false;
+        SDL_memset(alpha + ATLAS_WIDTH * atlas->h, 0, ATLAS_WIDTH * (new_h - atlas->h));
+        atlas->alpha = alpha;
+        atlas->h = new_h;
+    }
+    *x = atlas->shelf_x;
+    *y = atlas->shelf_y;
+    atlas->shelf_x += w;
+    atlas->shelf_h = SDL_max(atlas->shelf_h, h);
+    return true;
+}
+
+/* index of a glyph in the atlas, rasterized on first use. -1 on failure.
+   glyphs missing from the font are left empty and counted in missing
+*/
+static int atlas_get(AsciiContext *ctx, Uint32 codepoint, int *missing) {
+    GlyphAtlas *atlas = ctx->atlas;
+    if (!atlas_grow_map(atlas)) return -1;
+    int *slot = atlas_slot(atlas, codepoint);
+    if (*slot) return *slot - 1;
+
+    if (atlas->glyph_count == atlas->glyph_capacity) {
+        int capacity = atlas->glyph_capacity ? atlas->glyph_capacity * 2 : 128;
+        AtlasGlyph *glyphs = SDL_realloc(atlas->glyphs, capacity * sizeof(AtlasGlyph));
+        if (glyphs == NULL) return -1;
+        atlas->glyphs = glyphs;
+        atlas->glyph_capacity = capacity;
+    }
+    AtlasGlyph glyph = {.codepoint = codepoint};
+
+    SDL_Surface *rendered = NULL;
+    if (TTF_FontHasGlyph(ctx->ascii_font, codepoint))
+        rendered = TTF_RenderGlyph_Blended(ctx->ascii_font, codepoint, (SDL_Color){255, 255, 255, 255});
+    else
+        (*missing)++;
+    SDL_Surface *argb = rendered ? SDL_ConvertSurface(rendered, SDL_PIXELFORMAT_ARGB8888) : NULL;
+    SDL_DestroySurface(rendered);
+    if (argb) {
+        // glyphs without coverage, like spaces, are skipped when drawing
+        bool empty = true;
+        for (int y = 0; y < argb->h && empty; y++) {
+            Uint32 *src = (Uint32 *)((Uint8 *)argb->pixels + y * argb->pitch);
+            for (int x = 0; x < argb->w; x++) {
+                if (src[x] >> 24) {
+                    empty = false;
+                    break;
+                }
+            }
+        }
+        int w = SDL_min(argb->w, ATLAS_WIDTH);
+        if (!empty && atlas_pack(atlas, w, argb->h, &glyph.x, &glyph.y)) {
+            glyph.w = w;
+            glyph.h = argb->h;
+            for (int y = 0; y < glyph.h; y++) {
+                Uint32 *src = (Uint32 *)((Uint8 *)argb->pixels + y * argb->pitch);
+                Uint8 *dst = atlas->alpha + (glyph.y + y) * ATLAS_WIDTH + glyph.x;
+                for (int x = 0; x < glyph.w; x++) dst[x] = src[x] >> 24;
+            }
+            atlas->dirty = true;
+        }
+        SDL_DestroySurface(argb);
+    }
+
+    atlas->glyphs[atlas->glyph_count] = glyph;
+    *slot = ++atlas->glyph_count;
+    return atlas->glyph_count - 1;
+}
+
+// page of the current font size, a new size takes the least recently used page
+static GlyphAtlas *atlas_page(AsciiContext *ctx) {
+    float size = TTF_GetFontSize(ctx->ascii_font);
+    GlyphAtlas *page = NULL;
+    for (int p = 0; p < ATLAS_PAGES && page == NULL; p++) {
+        if (ctx->pages[p].font_size == size) page = &ctx->pages[p];
+    }
+    if (page == NULL) {
+        page = &ctx->pages[0];
+        for (int p = 1; p < ATLAS_PAGES; p++) {
+            if (ctx->pages[p].last_used < page->last_used) page = &ctx->pages[p];
+        }
+        atlas_reset(ctx, page, size);
+    }
+    page->last_used = ++ctx->atlas_clock;
+    return page;
+}
+
+// atlas glyph of every codepoint of a table on the current page
+static int *table_glyphs(AsciiContext *ctx, int table_index) {
+    return ctx->tables[table_index].atlas_glyphs[ctx->atlas - ctx->pages];
+}
+
+bool ascii_bake_glyphs(AsciiContext *ctx, int table_index) {
+    SDL_assert(table_index >= 0 && table_index < ctx->table_count);
+    GlyphAtlas *atlas = ctx->atlas = atlas_page(ctx);
+    int page = atlas - ctx->pages;
+
+    Table *table = &ctx->tables[table_index];
+    if (table->generation[page] == atlas->generation) return true;
+    if (table->atlas_glyphs[page] == NULL) {
+        table->atlas_glyphs[page] = SDL_malloc(table->len * sizeof(int));
+        if (table->atlas_glyphs[page] == NULL) return false;
+    }
+    int missing = 0;
+    for (int i = 0; i < table->len; i++) {
+        int glyph = atlas_get(ctx, table->codepoints[i], &missing);
+        if (glyph < 0) {
+            ERROR("Couldn't bake glyph U+%04X", table->codepoints[i]);
+            return false;
+        }
+        table->atlas_glyphs[page][i] = glyph;
+    }
+    if (missing > 0) ERROR("Font has no glyph for %d codepoints of table %d", missing, table_index);
+    table->generation[page] = atlas->generation;
+    return true;
+}
+
+// upload the atlas when glyphs were added, renderer thread only
+static bool atlas_upload(AsciiContext *ctx) {
+    GlyphAtlas *atlas = ctx->atlas;
+    if (!atlas->dirty && atlas->texture) return true;
+    int h = SDL_max(atlas->h, 1);
+    if (atlas->texture == NULL || atlas->texture->h != h) {
+        if (atlas->texture) SDL_DestroyTexture(atlas->texture);
+        atlas->texture = SDL_CreateTexture(ctx->renderer, SDL_PIXELFORMAT_ARGB8888,
+                                           SDL_TEXTUREACCESS_STATIC, ATLAS_WIDTH, h);
+        if (atlas->texture == NULL) {
+            ERROR("Couldn't create glyph atlas\n%s", SDL_GetError());
+            return false;
+        }
+        SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+        SDL_SetTextureScaleMode(atlas->texture, SDL_SCALEMODE_NEAREST);
+    }
+
+    // white glyphs, tinted per cell by vertex colors
+    Uint32 *pixels = SDL_malloc(ATLAS_WIDTH * h * sizeof(Uint32));
+    if (pixels == NULL) return false;
+    for (int i = 0; i < ATLAS_WIDTH * atlas->h; i++)
+        pixels[i] = (Uint32)atlas->alpha[i] << 24 | 0xFFFFFF;
+    if (atlas->h == 0) SDL_memset(pixels, 0, ATLAS_WIDTH * sizeof(Uint32));
+    SDL_UpdateTexture(atlas->texture, NULL, pixels, ATLAS_WIDTH * sizeof(Uint32));
+    SDL_free(pixels);
+    atlas->dirty = false;
+    return true;
+}
+
+static bool reserve_geometry(AsciiContext *ctx, int cells) {
+    if (cells <= ctx->geometry_capacity) return true;
+    SDL_Vertex *vertices = SDL_realloc(ctx->vertices, cells * 4 * sizeof(SDL_Vertex));
+    if (vertices == NULL) return false;
+    ctx->vertices = vertices;
+    int *indices = SDL_realloc(ctx->indices, cells * 6 * sizeof(int));
+    if (indices == NULL) return false;
+    ctx->indices = indices;
+    // two triangles per quad, never changes
+    for (int i = ctx->geometry_capacity; i < cells; i++) {
+        int *index = indices + i * 6;
+        int v = i * 4;
+        index[0] = v; index[1] = v + 1; index[2] = v + 2;
+        index[3] = v + 2; index[4] = v + 1; index[5] = v + 3;
+    }
+    ctx->geometry_capacity = cells;
+    return true;
+}
+
+#define HAS_BACKGROUND(cell) \
+    ((cell).bg_r != ASCII_BACKGROUND || (cell).bg_g != ASCII_BACKGROUND || (cell).bg_b != ASCII_BACKGROUND)
+
+#define DRAW_BATCH 16384 // quads per geometry call, bounds the buffers for huge grids
+// ascii_draw_changed redraws blocks of 64x32 cells
+#define DRAW_TILE_W 64
+#define DRAW_TILE_H 32
+
+static void flush_quads(AsciiContext *ctx, SDL_Texture *texture, int *quads) {
+    // the renderer copies vertices so the buffer is reused right away
+    if (*quads > 0)
+        SDL_RenderGeometry(ctx->renderer, texture, ctx->vertices, *quads * 4, ctx->indices, *quads * 6);
+    *quads = 0;
+}
+
+// untextured quads for the cells of r that have their own background
+static void draw_backgrounds(AsciiContext *ctx, AsciiGrid *grid, SDL_Rect r, float char_w, float char_h) {
+    int quads = 0;
+    for (int y = r.y; y < r.y + r.h; y++) {
+        int y0 = y * char_h, y1 = (y + 1) * char_h;
+        AsciiCell *row = grid->cells + y * grid->w;
+        for (int x = r.x; x < r.x + r.w; x++) {
+            AsciiCell cell = row[x];
+            if (!HAS_BACKGROUND(cell)) continue;
+
+            int x0 = x * char_w, x1 = (x + 1) * char_w;
+            SDL_FColor color = {cell.bg_r / 255.0f, cell.bg_g / 255.0f, cell.bg_b / 255.0f, 1.0f};
+            SDL_Vertex *v = ctx->vertices + quads * 4;
+            v[0] = (SDL_Vertex){{x0, y0}, color, {0, 0}};
+            v[1] = (SDL_Vertex){{x1, y0}, color, {0, 0}};
+            v[2] = (SDL_Vertex){{x0, y1}, color, {0, 0}};
+            v[3] = (SDL_Vertex){{x1, y1}, color, {0, 0}};
+            if (++quads == DRAW_BATCH) flush_quads(ctx, NULL, &quads);
+        }
+    }
+    flush_quads(ctx, NULL, &quads);
+}
+
+// textured quads from the atlas for the visible glyphs of r
+static void draw_glyphs(AsciiContext *ctx, AsciiGrid *grid, SDL_Rect r, float char_w, float char_h) {
+    GlyphAtlas *atlas = ctx->atlas;
+    int *glyphs = table_glyphs(ctx, grid->table_index);
+    float u_scale = 1.0f / ATLAS_WIDTH;
+    float v_scale = 1.0f / atlas->texture->h;
+    int quads = 0;
+    for (int y = r.y; y < r.y + r.h; y++) {
+        int y_pos = y * char_h;
+        AsciiCell *row = grid->cells + y * grid->w;
+        for (int x = r.x; x < r.x + r.w; x++) {
+            AsciiCell cell = row[x];
+            AtlasGlyph *glyph = &atlas->glyphs[glyphs[cell.glyph]];
+            if (glyph->w == 0) continue;
+
+            int x_pos = x * char_w;
+            SDL_FColor color = {cell.r / 255.0f, cell.g / 255.0f, cell.b / 255.0f, 1.0f};
+            float u0 = glyph->x * u_scale, u1 = (glyph->x + glyph->w) * u_scale;
+            float v0 = glyph->y * v_scale, v1 = (glyph->y + glyph->h) * v_scale;
+            SDL_Vertex *v = ctx->vertices + quads * 4;
+            v[0] = (SDL_Vertex){{x_pos, y_pos}, color, {u0, v0}};
+            v[1] = (SDL_Vertex){{x_pos + glyph->w, y_pos}, color, {u1, v0}};
+            v[2] = (SDL_Vertex){{x_pos, y_pos + glyph->h}, color, {u0, v1}};
+            v[3] = (SDL_Vertex){{x_pos + glyph->w, y_pos + glyph->h}, color, {u1, v1}};
+            if (++quads == DRAW_BATCH) flush_quads(ctx, atlas->texture, &quads);
+        }
+    }
+    flush_quads(ctx, atlas->texture, &quads);
+}
+
+static bool draw_prepare(AsciiContext *ctx, AsciiGrid *grid) {
+    return ascii_bake_glyphs(ctx, grid->table_index) && atlas_upload(ctx) &&
+           reserve_geometry(ctx, SDL_min(grid->w * grid->h, DRAW_BATCH));
+}
+
+/* cell backgrounds are untextured quads, then every visible glyph is a
+   textured quad from the atlas, each in as few calls as the batch allows
+*/
+void ascii_draw(AsciiContext *ctx, SDL_FRect *dst_rect, AsciiGrid *grid) {
+    SDL_SetRenderDrawColor(ctx->renderer, ASCII_BACKGROUND, ASCII_BACKGROUND, ASCII_BACKGROUND, 0xFF);
+    SDL_RenderClear(ctx->renderer);
+    if (!draw_prepare(ctx, grid)) return;
+
+    // cells fill the rect, as wide as the grid's cell shape makes them
+    float char_w = dst_rect->w / grid->w;
+    float char_h = dst_rect->h / grid->h;
+    SDL_Rect all = {0, 0, grid->w, grid->h};
+    draw_backgrounds(ctx, grid, all, char_w, char_h);
+    draw_glyphs(ctx, grid, all, char_w, char_h);
+}
 
-            render_ascii_char(c, x_pos, y_pos, color);
+static SDL_Rect draw_tile(AsciiGrid *grid, int tx, int ty) {
+    SDL_Rect r = {tx * DRAW_TILE_W, ty * DRAW_TILE_H, DRAW_TILE_W, DRAW_TILE_H};
+    r.w = SDL_min(r.w, grid->w - r.x);
+    r.h = SDL_min(r.h, grid->h - r.y);
+    return r;
+}
+
+void ascii_draw_changed(AsciiContext *ctx, SDL_FRect *dst_rect, AsciiGrid *grid, AsciiTarget *target) {
+    AsciiGrid *drawn = &target->grid;
+    int tw = (grid->w + DRAW_TILE_W - 1) / DRAW_TILE_W;
+    int th = (grid->h + DRAW_TILE_H - 1) / DRAW_TILE_H;
+    // baking can reset the atlas, compare its generation after
+    bool ok = draw_prepare(ctx, grid);
+    bool all = !target->valid || target->context_id != ctx->id || target->generation != ctx->atlas->generation ||
+               drawn->w != grid->w || drawn->h != grid->h || drawn->table_index != grid->table_index ||
+               target->rect.w != dst_rect->w || target->rect.h != dst_rect->h;
+    if (tw * th > ctx->dirty_capacity) {
+        Uint8 *dirty = SDL_realloc(ctx->dirty_tiles, tw * th);
+        if (dirty) {
+            ctx->dirty_tiles = dirty;
+            ctx->dirty_capacity = tw * th;
+        }
+    }
+    if (!ok || !ascii_grid_resize(drawn, grid->w, grid->h) || tw * th > ctx->dirty_capacity) {
+        target->valid = false;
+        ascii_draw(ctx, dst_rect, grid);
+        return;
+    }
+    target->valid = true;
+    target->context_id = ctx->id;
+    target->generation = ctx->atlas->generation;
+    target->rect = *dst_rect;
+    drawn->table_index = grid->table_index;
+    target->tiles_total = tw * th;
+
+    Uint8 *dirty = ctx->dirty_tiles;
+    int count = 0;
+    for (int ty = 0; ty < th; ty++) {
+        for (int tx = 0; tx < tw; tx++) {
+            SDL_Rect r = draw_tile(grid, tx, ty);
+            bool changed = all;
+            for (int y = r.y; y < r.y + r.h && !changed; y++) {
+                size_t offset = y * grid->w + r.x;
+                changed = SDL_memcmp(grid->cells + offset, drawn->cells + offset, r.w * sizeof(AsciiCell)) != 0;
+            }
+            dirty[ty * tw + tx] = changed;
+        }
+    }
+    // glyphs reach into the cells right of and below theirs, those tiles are redrawn too.
+    // backwards so every tile still sees the original flags of its neighbours
+    for (int ty = th - 1; ty >= 0; ty--) {
+        for (int tx = tw - 1; tx >= 0; tx--) {
+            Uint8 *d = dirty + ty * tw + tx;
+            *d |= (tx > 0 && d[-1]) | (ty > 0 && d[-tw]) | (tx > 0 && ty > 0 && d[-tw - 1]);
+            count += *d;
+        }
+    }
+    target->tiles_drawn = count;
+    if (count == 0) return;
+
+    // with most of it changed a plain redraw is cheaper than clipping every tile
+    if (all || count * 2 > tw * th) {
+        ascii_draw(ctx, dst_rect, grid);
+        SDL_memcpy(drawn->cells, grid->cells, grid->w * grid->h * sizeof(AsciiCell));
+        return;
+    }
+
+    float char_w = dst_rect->w / grid->w;
+    float char_h = dst_rect->h / grid->h;
+    SDL_SetRenderDrawColor(ctx->renderer, ASCII_BACKGROUND, ASCII_BACKGROUND, ASCII_BACKGROUND, 0xFF);
+    for (int ty = 0; ty < th; ty++) {
+        for (int tx = 0; tx < tw; tx++) {
+            if (!dirty[ty * tw + tx]) continue;
+            SDL_Rect r = draw_tile(grid, tx, ty);
+            for (int y = r.y; y < r.y + r.h; y++) {
+                size_t offset = y * grid->w + r.x;
+                SDL_memcpy(drawn->cells + offset, grid->cells + offset, r.w * sizeof(AsciiCell));
+            }
+
+            // pixels of the tile, cell edges round the same way as in ascii_draw
+            int x0 = r.x * char_w, y0 = r.y * char_h;
+            SDL_Rect clip = {x0, y0, (int)((r.x + r.w) * char_w) - x0, (int)((r.y + r.h) * char_h) - y0};
+            SDL_SetRenderClipRect(ctx->renderer, &clip);
+            SDL_RenderFillRect(ctx->renderer, NULL);
+            draw_backgrounds(ctx, grid, r, char_w, char_h);
+            // glyphs of the row above and column left reach into the tile
+            int rx = SDL_max(r.x - 1, 0), ry = SDL_max(r.y - 1, 0);
+            SDL_Rect reach = {rx, ry, r.x + r.w - rx, r.y + r.h - ry};
+            draw_glyphs(ctx, grid, reach, char_w, char_h);
+        }
+    }
+    SDL_SetRenderClipRect(ctx->renderer, NULL);
+}
+
+HOT_KERNEL void ascii_raster(AsciiContext *ctx, SDL_Surface *dst, AsciiGrid *grid) {
+    SDL_assert(dst->format == SDL_PIXELFORMAT_RGB24);
+    SDL_assert(ctx->tables[grid->table_index].generation[ctx->atlas - ctx->pages] == ctx->atlas->generation);
+
+    // background
+    for (int y = 0; y < dst->h; y++) {
+        SDL_memset((Uint8 *)dst->pixels + y * dst->pitch, ASCII_BACKGROUND, dst->w * BYTES_PER_PIXEL);
+    }
+
+    GlyphAtlas *atlas = ctx->atlas;
+    int *glyphs = table_glyphs(ctx, grid->table_index);
+    float char_w = (float)dst->w / grid->w;
+    float char_h = (float)dst->h / grid->h;
+    for (int y = 0; y < grid->h; y++) {
+        int y_pos = y * char_h;
+        AsciiCell *row = grid->cells + y * grid->w;
+        for (int x = 0; x < grid->w; x++) {
+            int x_pos = x * char_w;
+            AsciiCell cell = row[x];
+            if (HAS_BACKGROUND(cell)) {
+                int x1 = SDL_min((int)((x + 1) * char_w), dst->w);
+                int y1 = SDL_min((int)((y + 1) * char_h), dst->h);
+                for (int py = y_pos; py < y1; py++) {
+                    Uint8 *p = (Uint8 *)dst->pixels + py * dst->pitch + x_pos * BYTES_PER_PIXEL;
+                    for (int px = x_pos; px < x1; px++, p += BYTES_PER_PIXEL) {
+                        p[0] = cell.bg_r;
+                        p[1] = cell.bg_g;
+                        p[2] = cell.bg_b;
+                    }
+                }
+            }
+            AtlasGlyph *glyph = &atlas->glyphs[glyphs[cell.glyph]];
+            if (glyph->w == 0) continue;
+
+            // clip glyph to destination
+            int w = SDL_min(glyph->w, dst->w - x_pos);
+            int h = SDL_min(glyph->h, dst->h - y_pos);
+            for (int gy = 0; gy < h; gy++) {
+                Uint8 *a = atlas->alpha + (glyph->y + gy) * ATLAS_WIDTH + glyph->x;
+                Uint8 *p = (Uint8 *)dst->pixels + (y_pos + gy) * dst->pitch + x_pos * BYTES_PER_PIXEL;
+                for (int gx = 0; gx < w; gx++, p += BYTES_PER_PIXEL) {
+                    int alpha = a[gx];
+                    if (alpha == 0) continue;
+                    p[0] += ((cell.r - p[0]) * alpha) / 255;
+                    p[1] += ((cell.g - p[1]) * alpha) / 255;
+                    p[2] += ((cell.b - p[2]) * alpha) / 255;
+                }
+            }
         }
     }
 }
 
+/*  render the given surface with the ascii renderer.
+    dst_rect specifies size of render area.
+    set table_index to 0 for default
+    format is in RGB24 since webcam formats are so sus.
+*/
+void ascii_render(AsciiContext *ctx, SDL_FRect *dst_rect, SDL_Surface *frame, int table_index) {
+    SDL_assert(frame->format == SDL_PIXELFORMAT_RGB24);
+    SDL_assert(table_index >= 0 && table_index < ctx->table_count);
+
+    if (!ascii_grid_resize(&ctx->render_grid, frame->w, frame->h)) return;
+    ascii_compute(ctx, &ctx->render_grid, frame, table_index);
+    ascii_draw(ctx, dst_rect, &ctx->render_grid);
+}
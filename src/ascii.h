@@ -3,24 +3,158 @@
 #include <SDL3/SDL.h>
 
 #define DEFAULT_RES 100
+// grid width range of the live view
+#define LIMIT_LOWER 16
+#define LIMIT_UPPER 960
+// narrowest cell in pixels, caps the columns below LIMIT_UPPER on smaller screens
+#define MIN_CELL_WIDTH 4
+// gray level behind the cells
+#define ASCII_BACKGROUND 0x18
 
+// one computed cell. glyph is an index into the cells table
+typedef struct {
+    Uint16 glyph;
+    Uint8 r, g, b;
+    Uint8 bg_r, bg_g, bg_b; // ASCII_BACKGROUND for cells without their own background
+} AsciiCell;
 
-/* Initialize ascii rendering.
-   table file can be NULL for default
+// how cells are computed from a frame
+typedef enum {
+    ASCII_MODE_TABLE,   // a table glyph per pixel picked by luma
+    ASCII_MODE_BRAILLE, // braille dots thresholded from 2x4 pixels per cell
+    ASCII_MODE_HALF,    // upper half block, top pixel as color and bottom as background
+    ASCII_MODE_COUNT,
+} AsciiMode;
+
+typedef struct AsciiTiles AsciiTiles;
+
+// grid of cells computed from a frame, w x h matches the frame size
+typedef struct {
+    int w;
+    int h;
+    int table_index;
+    int capacity;
+    AsciiCell *cells;
+
+    /* above 0 ascii_compute_mode only recomputes blocks of cells whose
+       pixels moved by more than this since they were computed, the rest
+       keep their cells. for still cameras, costs a copy of the frame.
+       half block mode always computes everything
+    */
+    int tile_threshold;
+    AsciiTiles *tiles;
+} AsciiGrid;
+
+/* All ascii state (fonts, tables, glyph atlases, scratch buffers) lives
+   in a context, so independent renderers can run on different threads.
+   a context itself is not thread safe except where noted.
 */
-void ascii_init(SDL_Renderer *renderer, float font_size, char *table_file);
-void ascii_deinit();
+typedef struct AsciiContext AsciiContext;
 
-// update font size for ascii renderer
-void ascii_update_font_size(float size);
-// must be called after ascii_init
-int ascii_get_table_count();
+/* Create an ascii renderer.
+   renderer can be NULL when only ascii_raster is used.
+   table file can be NULL for default, it holds one UTF-8 table per line
+*/
+AsciiContext *ascii_create(SDL_Renderer *renderer, float font_size, const char *table_file);
+void ascii_destroy(AsciiContext *ctx);
+/* attach a renderer to a context created without one, so fonts can be
+   loaded on another thread before the renderer exists. call on the
+   renderer thread
+*/
+bool ascii_set_renderer(AsciiContext *ctx, SDL_Renderer *renderer);
+
+// update font size for ascii renderer, a cell is one line of the font high
+void ascii_update_font_size(AsciiContext *ctx, float size);
+/* width over height of the cells the ascii font fills, its glyph advance
+   over its line height. a grid of w columns over a W x H frame fits the glyphs
+   with w * H / W * aspect rows. ascii_draw and ascii_raster take the cell
+   shape from the grid and the output size
+*/
+float ascii_cell_aspect(AsciiContext *ctx);
+// font size whose line height is cell_h, line height and size differ by the font's leading
+float ascii_cell_font_size(AsciiContext *ctx, float cell_h);
+/* rows of a grid cols wide over a frame aspect_ratio high per unit of width,
+   cells shaped like the glyphs. returns the font size filling an output
+   height pixels high with them
+*/
+float ascii_grid_font_size(AsciiContext *ctx, int cols, float aspect_ratio, float height, int *rows);
+// tables read from files, modes with their own table come after these
+int ascii_get_table_count(AsciiContext *ctx);
+// codepoints of a table, cell glyphs index into it
+const Uint32 *ascii_get_table(AsciiContext *ctx, int table_index, int *len);
+// the same table as it was read, UTF-8 without a terminating newline
+const char *ascii_get_table_utf8(AsciiContext *ctx, int table_index, size_t *bytes);
 // ascii rendering
-void ascii_render(SDL_Renderer *renderer, SDL_FRect *dst_rect, SDL_Surface *frame, int table_index);
+void ascii_render(AsciiContext *ctx, SDL_FRect *dst_rect, SDL_Surface *frame, int table_index);
+
+/* part of a source frame that is sampled, x y w h in 0..1 of its size.
+   mirror flips it horizontally, e.g. for a selfie view
+*/
+typedef struct {
+    float x, y, w, h;
+    bool mirror;
+} AsciiView;
+
+#define ASCII_VIEW_FULL ((AsciiView){.x = 0, .y = 0, .w = 1, .h = 1})
+
+/* sampling stage, nearest neighbour from the view of src into dst, which
+   must be RGB24. src can be in any format. zooming in reads fewer source
+   pixels, cropping and mirroring need no pass of their own
+*/
+bool ascii_sample(SDL_Surface *src, const AsciiView *view, SDL_Surface *dst);
+
+// grid storage, resize only reallocates when growing
+bool ascii_grid_resize(AsciiGrid *grid, int w, int h);
+void ascii_grid_free(AsciiGrid *grid);
+/* compute stage of ascii_render, frame must be RGB24 and the size of the grid.
+   only reads the tables so it can run on any thread
+*/
+void ascii_compute(AsciiContext *ctx, AsciiGrid *grid, SDL_Surface *frame, int table_index);
+/* frames for a mode are w * sx by h * sy pixels for a w x h grid.
+   ascii_compute_mode runs the compute stage of any mode, table_index is
+   ignored by modes with their own table. same threading as ascii_compute
+*/
+void ascii_mode_scale(AsciiMode mode, int *sx, int *sy);
+const char *ascii_mode_name(AsciiMode mode);
+// table the cells of a mode index into
+int ascii_mode_table(AsciiContext *ctx, AsciiMode mode, int table_index);
+void ascii_compute_mode(AsciiContext *ctx, AsciiMode mode, AsciiGrid *grid, SDL_Surface *frame, int table_index);
+// simd path the compute kernels were built with, "sse2" or "scalar"
+const char *ascii_simd();
+// blocks of cells the last ascii_compute_mode recomputed, with a tile threshold
+void ascii_tile_stats(AsciiGrid *grid, int *computed, int *total);
+// draw stage of ascii_render
+void ascii_draw(AsciiContext *ctx, SDL_FRect *dst_rect, AsciiGrid *grid);
+
+// what a render target shows, zero initialize and free the grid when done
+typedef struct {
+    bool valid; // set false to redraw everything, e.g. after recreating the target
+    AsciiGrid grid; // cells in the target
+    Uint32 context_id;
+    Uint32 generation;
+    SDL_FRect rect;
+    int tiles_drawn; // of the last ascii_draw_changed
+    int tiles_total;
+} AsciiTarget;
+
+/* ascii_draw into a target that kept its pixels, redrawing only the
+   blocks of cells that differ from what it shows. geometry and fill stay
+   proportional to the change for grids of any size. mostly changed frames,
+   another size, table or font size draw everything
+*/
+void ascii_draw_changed(AsciiContext *ctx, SDL_FRect *dst_rect, AsciiGrid *grid, AsciiTarget *target);
+
+/* software rasterizer for offline output, no renderer needed.
+   glyphs of a table are baked into the glyph atlas at the current ascii
+   font size and ascii_raster can then be called from any thread until
+   the size changes. dst must be RGB24
+*/
+bool ascii_bake_glyphs(AsciiContext *ctx, int table_index);
+void ascii_raster(AsciiContext *ctx, SDL_Surface *dst, AsciiGrid *grid);
 
 // update font size for regular text renderer
-void update_font_size(float size);
-void render_string(char *str, int x, int y, SDL_Color c);
-void measure_string(char *str, int *w, int *h);
+void update_font_size(AsciiContext *ctx, float size);
+void render_string(AsciiContext *ctx, char *str, int x, int y, SDL_Color c);
+void measure_string(AsciiContext *ctx, char *str, int *w, int *h);
 
 #endif
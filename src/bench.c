@@ -0,0 +1,646 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL.h>
+
+#include "alloc_stats.h"
+#include "ascii.h"
+#include "bench.h"
+#include "perf_counters.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+// the live view draws into the window minus the side bar, wider grids get a wider view
+#define OUTPUT_WIDTH 1050
+#define SYNTHETIC_W 1280
+#define SYNTHETIC_H 720
+#define SYNTHETIC_FRAMES 8
+#define MAX_FILE_FRAMES 64
+#define MAX_HEADER_LEN 1024
+
+#define MAX_SAMPLES 100000
+#define WARMUP 3
+#define MIN_ITERATIONS 10
+#define DEFAULT_MIN_MS 100
+#define DEFAULT_FRAMES 120
+#define DEFAULT_THRESHOLD 10.0
+
+// soak runs each mode in turn, steady state starts after every mode warmed up
+#define SOAK_MODE_FRAMES 600
+#define SOAK_WARMUP_FRAMES 100
+#define SOAK_REPORT_NS (10 * SDL_NS_PER_SECOND)
+// tile skipping is timed on a still frame, only the comparison is left
+#define TILE_THRESHOLD 8
+// resident memory may move a little without a leak
+#define SOAK_RSS_SLACK (4 << 20)
+
+typedef struct {
+    char name[64];
+    int iterations;
+    Uint64 median_ns;
+    Uint64 p99_ns;
+    Uint64 baseline_ns; // 0 without a baseline
+    double allocs; // per iteration, with the counting allocator
+    double bytes;
+    int cells;
+    double counters[PERF_COUNTER_COUNT]; // per iteration, with hardware counters
+} BenchResult;
+
+// everything the stages of one grid size and mode work on
+typedef struct {
+    SDL_Surface **sources;
+    int source_count;
+    AsciiMode mode;
+    SDL_Surface *frame; // sources sampled for the mode
+    AsciiGrid grid;
+    AsciiGrid prev;
+    AsciiGrid tiles; // computed with a tile threshold
+    SDL_Surface *target; // ascii_raster output
+    SDL_Texture *fbo; // render target of the output size, like the live view's
+    AsciiTarget drawn; // what ascii_draw_changed left in fbo
+    SDL_Renderer *renderer;
+    SDL_FRect rect;
+} BenchCase;
+
+typedef void (*BenchFn)(BenchCase *c, int iteration);
+
+struct {
+    AsciiContext *ascii;
+    SDL_Renderer *renderer;
+    Uint64 min_ns;
+    int frames;
+    bool perf; // hardware counters around every benchmark
+
+    Uint64 *samples;
+    BenchResult *results;
+    int result_count;
+    int result_capacity;
+    volatile int sink; // keeps the result of pure stages alive
+} bench_state = {0};
+
+//---Stages---
+
+// the live view's sampling, the whole source like an unzoomed camera
+static void stage_downscale(BenchCase *c, int i) {
+    ascii_sample(c->sources[i % c->source_count], &ASCII_VIEW_FULL, c->frame);
+}
+
+// zoomed in two times on the centre and mirrored, like a zoomed selfie view
+static void stage_zoom(BenchCase *c, int i) {
+    static const AsciiView view = {.x = 0.25f, .y = 0.25f, .w = 0.5f, .h = 0.5f, .mirror = true};
+    ascii_sample(c->sources[i % c->source_count], &view, c->frame);
+}
+
+static void stage_compute(BenchCase *c, int i) {
+    (void)i;
+    ascii_compute_mode(bench_state.ascii, c->mode, &c->grid, c->frame, 0);
+}
+
+static void stage_tiles(BenchCase *c, int i) {
+    (void)i;
+    ascii_compute_mode(bench_state.ascii, c->mode, &c->tiles, c->frame, 0);
+}
+
+// changed cells between two grids, like the browser view's deltas
+static void stage_diff(BenchCase *c, int i) {
+    (void)i;
+    int changed = 0;
+    for (int k = 0; k < c->grid.w * c->grid.h; k++)
+        changed += SDL_memcmp(&c->grid.cells[k], &c->prev.cells[k], sizeof(AsciiCell)) != 0;
+    bench_state.sink = changed;
+}
+
+static void stage_draw(BenchCase *c, int i) {
+    (void)i;
+    SDL_SetRenderTarget(c->renderer, c->fbo);
+    ascii_draw(bench_state.ascii, &c->rect, &c->grid);
+    SDL_SetRenderTarget(c->renderer, NULL);
+    SDL_FlushRenderer(c->renderer);
+}
+
+static void draw_changed(BenchCase *c, AsciiGrid *grid) {
+    SDL_SetRenderTarget(c->renderer, c->fbo);
+    ascii_draw_changed(bench_state.ascii, &c->rect, grid, &c->drawn);
+    SDL_SetRenderTarget(c->renderer, NULL);
+    SDL_FlushRenderer(c->renderer);
+}
+
+// the live view's draw, alternating between two consecutive frames
+static void stage_changed(BenchCase *c, int i) {
+    draw_changed(c, i % 2 ? &c->prev : &c->grid);
+}
+
+static void stage_raster(BenchCase *c, int i) {
+    (void)i;
+    ascii_raster(bench_state.ascii, c->target, &c->grid);
+}
+
+// the live loop without camera and window
+static void stage_frame(BenchCase *c, int i) {
+    stage_downscale(c, i);
+    stage_compute(c, i);
+    draw_changed(c, &c->grid);
+}
+
+//---Timing---
+
+static int compare_ns(const void *a, const void *b) {
+    Uint64 x = *(const Uint64 *)a;
+    Uint64 y = *(const Uint64 *)b;
+    return x < y ? -1 : x > y;
+}
+
+// time fn until both min_iterations and min_ns are reached
+static bool run(const char *name, BenchFn fn, BenchCase *c, int min_iterations, Uint64 min_ns) {
+    if (bench_state.result_count == bench_state.result_capacity) {
+        int capacity = bench_state.result_capacity ? bench_state.result_capacity * 2 : 64;
+        BenchResult *results = realloc(bench_state.results, capacity * sizeof(BenchResult));
+        if (results == NULL) return false;
+        bench_state.results = results;
+        bench_state.result_capacity = capacity;
+    }
+
+    for (int i = 0; i < WARMUP; i++) fn(c, i);
+    int n = 0;
+    AllocStats before = alloc_stats_get();
+    PerfCounts counters_before;
+    if (bench_state.perf) perf_counters_read(&counters_before);
+    Uint64 start = SDL_GetTicksNS();
+    while (n < MAX_SAMPLES && (n < min_iterations || SDL_GetTicksNS() - start < min_ns)) {
+        Uint64 t = SDL_GetTicksNS();
+        fn(c, n);
+        bench_state.samples[n++] = SDL_GetTicksNS() - t;
+    }
+    PerfCounts counters_after;
+    if (bench_state.perf) perf_counters_read(&counters_after);
+    AllocStats after = alloc_stats_get();
+    SDL_qsort(bench_state.samples, n, sizeof(Uint64), compare_ns);
+
+    BenchResult *r = &bench_state.results[bench_state.result_count++];
+    *r = (BenchResult){
+        .iterations = n,
+        .median_ns = bench_state.samples[n / 2],
+        .p99_ns = bench_state.samples[(n - 1) * 99 / 100],
+        .allocs = (double)(after.allocs - before.allocs) / n,
+        .bytes = (double)(after.bytes - before.bytes) / n,
+        .cells = c->grid.w * c->grid.h,
+    };
+    SDL_strlcpy(r->name, name, sizeof(r->name));
+    if (!bench_state.perf) {
+        SDL_Log("%-36s %10.1f us  p99 %10.1f us", name, r->median_ns / 1e3, r->p99_ns / 1e3);
+        return true;
+    }
+    for (int k = 0; k < PERF_COUNTER_COUNT; k++)
+        r->counters[k] = (double)(counters_after.values[k] - counters_before.values[k]) / n;
+    double cycles = r->counters[PERF_CYCLES];
+    SDL_Log("%-36s %10.1f us  p99 %10.1f us  ipc %5.2f  cache misses/cell %7.3f", name, r->median_ns / 1e3,
+            r->p99_ns / 1e3, cycles ? r->counters[PERF_INSTRUCTIONS] / cycles : 0.0,
+            r->counters[PERF_CACHE_MISSES] / r->cells);
+    return true;
+}
+
+//---Sources---
+
+// moving gradients with a bright square so consecutive frames differ like camera frames
+static SDL_Surface *make_synthetic(int t) {
+    SDL_Surface *s = SDL_CreateSurface(SYNTHETIC_W, SYNTHETIC_H, SDL_PIXELFORMAT_RGB24);
+    if (s == NULL) return NULL;
+    int sq_x = t * SYNTHETIC_W / (2 * SYNTHETIC_FRAMES);
+    int sq_y = SYNTHETIC_H / 4;
+    for (int y = 0; y < s->h; y++) {
+        Uint8 *p = (Uint8 *)s->pixels + y * s->pitch;
+        for (int x = 0; x < s->w; x++, p += 3) {
+            bool square = x >= sq_x && x < sq_x + SYNTHETIC_H / 2 && y >= sq_y && y < sq_y + SYNTHETIC_H / 2;
+            p[0] = square ? 255 : (x + t * 8) & 255;
+            p[1] = square ? 255 : (y * 2 + t * 4) & 255;
+            p[2] = square ? 255 : ((x ^ y) + t * 16) & 255;
+        }
+    }
+    return s;
+}
+
+// up to MAX_FILE_FRAMES of a 4:2:0 Y4M file, what recordings and transcode write
+static int load_y4m(const char *path, SDL_Surface **frames) {
+    size_t size = 0;
+    char *data = SDL_LoadFile(path, &size);
+    if (data == NULL) {
+        ERROR("Couldn't read %s\n%s", path, SDL_GetError());
+        return 0;
+    }
+
+    char header[MAX_HEADER_LEN];
+    char *eol = memchr(data, '\n', size);
+    int w = 0, h = 0;
+    bool full_range = false;
+    bool is_420 = true;
+    if (eol && eol - data < MAX_HEADER_LEN && SDL_strncmp(data, "YUV4MPEG2 ", 10) == 0) {
+        SDL_strlcpy(header, data + 10, eol - data - 9);
+        char *save = NULL;
+        for (char *tok = SDL_strtok_r(header, " ", &save); tok; tok = SDL_strtok_r(NULL, " ", &save)) {
+            if (tok[0] == 'W') w = SDL_atoi(tok + 1);
+            else if (tok[0] == 'H') h = SDL_atoi(tok + 1);
+            else if (tok[0] == 'C') is_420 = SDL_strncmp(tok + 1, "420", 3) == 0;
+            else if (SDL_strcmp(tok, "XCOLORRANGE=FULL") == 0) full_range = true;
+        }
+    }
+    if (w <= 0 || h <= 0 || !is_420) {
+        ERROR("%s is not a 4:2:0 Y4M file", path);
+        SDL_free(data);
+        return 0;
+    }
+
+    size_t frame_size = (size_t)w * h + 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2);
+    char *end = data + size;
+    char *p = eol + 1;
+    int count = 0;
+    while (count < MAX_FILE_FRAMES) {
+        char *line = memchr(p, '\n', end - p);
+        if (line == NULL || (size_t)(end - line - 1) < frame_size) break;
+        SDL_Surface *frame = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGB24);
+        if (frame == NULL) break;
+        SDL_ConvertPixelsAndColorspace(w, h, SDL_PIXELFORMAT_IYUV,
+                                       full_range ? SDL_COLORSPACE_BT601_FULL : SDL_COLORSPACE_BT601_LIMITED, 0,
+                                       line + 1, w, SDL_PIXELFORMAT_RGB24, SDL_COLORSPACE_SRGB, 0,
+                                       frame->pixels, frame->pitch);
+        frames[count++] = frame;
+        p = line + 1 + frame_size;
+    }
+    SDL_free(data);
+    if (count == 0) ERROR("%s has no frames", path);
+    return count;
+}
+
+//---Runs---
+
+static bool case_create(BenchCase *c, SDL_Surface **frames, int count, AsciiMode mode, int cols, int rows, SDL_FRect rect) {
+    int sx, sy;
+    ascii_mode_scale(mode, &sx, &sy);
+    *c = (BenchCase){
+        .sources = frames,
+        .source_count = count,
+        .mode = mode,
+        .frame = SDL_CreateSurface(cols * sx, rows * sy, SDL_PIXELFORMAT_RGB24),
+        .target = SDL_CreateSurface(rect.w, rect.h, SDL_PIXELFORMAT_RGB24),
+        .fbo = SDL_CreateTexture(bench_state.renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_TARGET, rect.w, rect.h),
+        .renderer = bench_state.renderer,
+        .rect = rect,
+    };
+    if (!c->frame || !c->target || !c->fbo || !ascii_grid_resize(&c->grid, cols, rows) || !ascii_grid_resize(&c->prev, cols, rows) ||
+        !ascii_grid_resize(&c->tiles, cols, rows))
+        return false;
+    c->tiles.tile_threshold = TILE_THRESHOLD;
+
+    // prev is one frame behind so the diff sees real changes
+    stage_downscale(c, count > 1 ? 1 : 0);
+    stage_compute(c, 0);
+    SDL_memcpy(c->prev.cells, c->grid.cells, cols * rows * sizeof(AsciiCell));
+    c->prev.table_index = c->grid.table_index;
+    stage_downscale(c, 0);
+    stage_compute(c, 0);
+    return true;
+}
+
+static void case_destroy(BenchCase *c) {
+    SDL_DestroySurface(c->frame);
+    SDL_DestroySurface(c->target);
+    SDL_DestroyTexture(c->fbo);
+    ascii_grid_free(&c->grid);
+    ascii_grid_free(&c->prev);
+    ascii_grid_free(&c->tiles);
+    ascii_grid_free(&c->drawn.grid);
+}
+
+/* every grid size from LIMIT_LOWER to LIMIT_UPPER and every mode, the
+   stages on their own with stages set and always the whole frame
+*/
+static bool bench_source(const char *source, SDL_Surface **frames, int count, bool stages) {
+    int src_w = frames[0]->w;
+    int src_h = frames[0]->h;
+    // grid widths double from LIMIT_LOWER and always end at LIMIT_UPPER
+    for (int cols = LIMIT_LOWER;; cols = SDL_min(cols * 2, LIMIT_UPPER)) {
+        // cells at least MIN_CELL_WIDTH wide like the live view allows
+        float width = SDL_max(OUTPUT_WIDTH, cols * MIN_CELL_WIDTH);
+        SDL_FRect rect = {0, 0, width, width * src_h / src_w};
+        int rows;
+        ascii_update_font_size(bench_state.ascii,
+                               ascii_grid_font_size(bench_state.ascii, cols, (float)src_h / src_w, rect.h, &rows));
+
+        for (int mode = 0; mode < ASCII_MODE_COUNT; mode++) {
+            BenchCase c;
+            bool ok = case_create(&c, frames, count, mode, cols, rows, rect);
+
+            char name[64];
+            const char *mode_name = ascii_mode_name(mode);
+            if (ok && stages) {
+                struct { const char *name; BenchFn fn; } list[] = {
+                    {"downscale", stage_downscale},
+                    {"zoom", stage_zoom},
+                    {"compute", stage_compute},
+                    {"tiles", stage_tiles},
+                    {"diff", stage_diff},
+                    {"draw", stage_draw},
+                    {"changed", stage_changed},
+                    {"raster", stage_raster},
+                };
+                for (int i = 0; ok && i < (int)SDL_arraysize(list); i++) {
+                    SDL_snprintf(name, sizeof(name), "%s/%s/%dx%d", list[i].name, mode_name, cols, rows);
+                    ok = run(name, list[i].fn, &c, MIN_ITERATIONS, bench_state.min_ns);
+                }
+            }
+            if (ok) {
+                SDL_snprintf(name, sizeof(name), "frame/%s/%s/%dx%d", source, mode_name, cols, rows);
+                ok = run(name, stage_frame, &c, bench_state.frames, 0);
+            }
+
+            case_destroy(&c);
+            if (!ok) {
+                ERROR("Benchmark %s failed at %dx%d", source, cols, rows);
+                return false;
+            }
+        }
+        if (cols == LIMIT_UPPER) break;
+    }
+    return true;
+}
+
+/* whole frames at the default size for the given time, modes take turns.
+   once every mode ran for a while nothing may be allocated anymore and
+   neither live nor resident memory may grow
+*/
+static bool soak(SDL_Surface **frames, int count, Uint64 duration_ns) {
+    float aspect_ratio = (float)frames[0]->h / frames[0]->w;
+    SDL_FRect rect = {0, 0, OUTPUT_WIDTH, OUTPUT_WIDTH * aspect_ratio};
+    int rows;
+    ascii_update_font_size(bench_state.ascii,
+                           ascii_grid_font_size(bench_state.ascii, DEFAULT_RES, aspect_ratio, rect.h, &rows));
+
+    BenchCase cases[ASCII_MODE_COUNT] = {0};
+    bool ok = true;
+    for (int mode = 0; mode < ASCII_MODE_COUNT; mode++) {
+        ok = ok && case_create(&cases[mode], frames, count, mode, DEFAULT_RES, rows, rect);
+        for (int i = 0; ok && i < SOAK_WARMUP_FRAMES; i++) stage_frame(&cases[mode], i);
+    }
+    if (!ok) {
+        ERROR("Soak setup failed");
+        for (int mode = 0; mode < ASCII_MODE_COUNT; mode++) case_destroy(&cases[mode]);
+        return false;
+    }
+
+    static const char *stage_names[] = {"downscale", "compute", "draw"};
+    Uint64 stage_allocs[3] = {0};
+    AllocStats base = alloc_stats_get();
+    size_t base_rss = alloc_stats_rss();
+    Uint64 start = SDL_GetTicksNS();
+    Uint64 next_report = start + SOAK_REPORT_NS;
+    Uint64 frame = 0;
+    for (Uint64 now = start; now - start < duration_ns; now = SDL_GetTicksNS(), frame++) {
+        BenchCase *c = &cases[frame / SOAK_MODE_FRAMES % ASCII_MODE_COUNT];
+        AllocStats a = alloc_stats_get();
+        stage_downscale(c, frame);
+        AllocStats b = alloc_stats_get();
+        stage_compute(c, frame);
+        AllocStats d = alloc_stats_get();
+        draw_changed(c, &c->grid);
+        AllocStats e = alloc_stats_get();
+        stage_allocs[0] += b.allocs - a.allocs;
+        stage_allocs[1] += d.allocs - b.allocs;
+        stage_allocs[2] += e.allocs - d.allocs;
+
+        if (now >= next_report) {
+            next_report += SOAK_REPORT_NS;
+            AllocStats s = alloc_stats_get();
+            SDL_Log("soak %4.0fs %8llu frames  %.3f allocs/frame (%s %llu, %s %llu, %s %llu)  live %lld KB  peak %lld KB  rss %zu KB",
+                    (now - start) / 1e9, (unsigned long long)frame, (double)(s.allocs - base.allocs) / SDL_max(frame, 1),
+                    stage_names[0], (unsigned long long)stage_allocs[0], stage_names[1], (unsigned long long)stage_allocs[1],
+                    stage_names[2], (unsigned long long)stage_allocs[2], (long long)s.live_bytes / 1024,
+                    (long long)s.peak_bytes / 1024, alloc_stats_rss() / 1024);
+        }
+    }
+
+    AllocStats end = alloc_stats_get();
+    size_t end_rss = alloc_stats_rss();
+    unsigned long long allocs = end.allocs - base.allocs;
+    long long live_growth = end.live_bytes - base.live_bytes;
+    long long rss_growth = (long long)end_rss - (long long)base_rss;
+    SDL_Log("soak done: %llu frames, %llu allocations, live %+lld bytes, rss %+lld KB",
+            (unsigned long long)frame, allocs, live_growth, rss_growth / 1024);
+    bool passed = true;
+    if (!alloc_stats_installed()) {
+        ERROR("Allocations aren't counted, only resident memory is checked");
+    } else if (allocs > 0 || live_growth > 0) {
+        ERROR("Steady state allocated %llu times, live memory grew %lld bytes", allocs, live_growth);
+        passed = false;
+    }
+    if (rss_growth > SOAK_RSS_SLACK) {
+        ERROR("Resident memory grew %lld KB", rss_growth / 1024);
+        passed = false;
+    }
+
+    for (int mode = 0; mode < ASCII_MODE_COUNT; mode++) case_destroy(&cases[mode]);
+    return passed;
+}
+
+//---Output---
+
+// reads medians back from a file this writes, returns regressions over threshold or -1
+static int compare_baseline(const char *path, double threshold) {
+    size_t size = 0;
+    char *data = SDL_LoadFile(path, &size);
+    if (data == NULL) {
+        ERROR("Couldn't read baseline %s\n%s", path, SDL_GetError());
+        return -1;
+    }
+    static const char name_key[] = "\"name\": \"";
+    static const char median_key[] = "\"median_ns\": ";
+    for (char *p = data; (p = SDL_strstr(p, name_key)) != NULL;) {
+        p += sizeof(name_key) - 1;
+        char *end = SDL_strchr(p, '"');
+        char *median = end ? SDL_strstr(end, median_key) : NULL;
+        if (median == NULL) break;
+        Uint64 ns = SDL_strtoull(median + sizeof(median_key) - 1, NULL, 10);
+        for (int i = 0; i < bench_state.result_count; i++) {
+            BenchResult *r = &bench_state.results[i];
+            if (SDL_strlen(r->name) == (size_t)(end - p) && SDL_strncmp(r->name, p, end - p) == 0)
+                r->baseline_ns = ns;
+        }
+        p = end;
+    }
+    SDL_free(data);
+
+    int regressions = 0;
+    for (int i = 0; i < bench_state.result_count; i++) {
+        BenchResult *r = &bench_state.results[i];
+        if (r->baseline_ns == 0) continue;
+        double change = 100.0 * ((double)r->median_ns / r->baseline_ns - 1.0);
+        bool regressed = change > threshold;
+        regressions += regressed;
+        SDL_Log("%-36s %10.1f us  %+6.1f%%%s", r->name, r->median_ns / 1e3, change, regressed ? "  REGRESSION" : "");
+    }
+    SDL_Log("%d regressions over %.1f%%", regressions, threshold);
+    return regressions;
+}
+
+// cycles and instructions per iteration, everything else per grid cell
+static void write_counters(FILE *out, BenchResult *r) {
+    fprintf(out, ", \"cells\": %d", r->cells);
+    for (int k = 0; k < PERF_COUNTER_COUNT; k++) {
+        if (!perf_counters_has(k)) continue;
+        bool per_iter = k == PERF_CYCLES || k == PERF_INSTRUCTIONS;
+        fprintf(out, ", \"%s_per_%s\": %.*f", perf_counter_name(k), per_iter ? "iter" : "cell", per_iter ? 0 : 4,
+                per_iter ? r->counters[k] : r->counters[k] / r->cells);
+    }
+    if (perf_counters_has(PERF_CYCLES) && perf_counters_has(PERF_INSTRUCTIONS) && r->counters[PERF_CYCLES] > 0)
+        fprintf(out, ", \"ipc\": %.3f", r->counters[PERF_INSTRUCTIONS] / r->counters[PERF_CYCLES]);
+}
+
+static bool write_json(FILE *out) {
+    fprintf(out, "{\n  \"frames\": %d,\n  \"min_ms\": %llu,\n  \"simd\": \"%s\",\n  \"results\": [\n",
+            bench_state.frames, (unsigned long long)(bench_state.min_ns / 1000000), ascii_simd());
+    for (int i = 0; i < bench_state.result_count; i++) {
+        BenchResult *r = &bench_state.results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"iterations\": %d, \"median_ns\": %llu, \"p99_ns\": %llu, \"fps\": %.1f",
+                r->name, r->iterations, (unsigned long long)r->median_ns, (unsigned long long)r->p99_ns,
+                r->median_ns ? 1e9 / r->median_ns : 0.0);
+        if (alloc_stats_installed())
+            fprintf(out, ", \"allocs_per_iter\": %.2f, \"bytes_per_iter\": %.0f", r->allocs, r->bytes);
+        if (bench_state.perf) write_counters(out, r);
+        if (r->baseline_ns)
+            fprintf(out, ", \"baseline_median_ns\": %llu, \"change\": %.4f", (unsigned long long)r->baseline_ns,
+                    (double)r->median_ns / r->baseline_ns - 1.0);
+        fprintf(out, "}%s\n", i < bench_state.result_count - 1 ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    return fflush(out) == 0 && !ferror(out);
+}
+
+static void print_usage() {
+    SDL_Log("Usage: j-ascii bench [options]");
+    SDL_Log("  -f <.tbl file>     ascii table file");
+    SDL_Log("  -i <in.y4m>        also run whole frames from a 4:2:0 Y4M file");
+    SDL_Log("  -o <out.json>      write results here instead of stdout");
+    SDL_Log("  -b <base.json>     compare against an earlier run, regressions fail");
+    SDL_Log("  --threshold <pct>  slowdown counted as a regression (default %.0f)", DEFAULT_THRESHOLD);
+    SDL_Log("  -t <ms>            minimum time per stage benchmark (default %d)", DEFAULT_MIN_MS);
+    SDL_Log("  -n <frames>        frames per whole frame benchmark (default %d)", DEFAULT_FRAMES);
+    SDL_Log("  --perf             hardware counters per benchmark, ipc and misses per cell (Linux)");
+    SDL_Log("  --soak <seconds>   only run whole frames this long, fails if memory is allocated");
+    SDL_Log("                     or grows once warmed up");
+}
+
+int bench_main(int argc, char *argv[]) {
+    char *table_file = NULL;
+    char *in_path = NULL;
+    char *out_path = NULL;
+    char *baseline_path = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+    int soak_seconds = 0;
+    int min_ms = DEFAULT_MIN_MS;
+    bench_state.frames = DEFAULT_FRAMES;
+
+    // args
+    for (int i = 0; i < argc; i++) {
+        char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_usage();
+            return 0;
+        } else if (strcmp(arg, "-f") == 0 && has_value) {
+            table_file = argv[++i];
+        } else if (strcmp(arg, "-i") == 0 && has_value) {
+            in_path = argv[++i];
+        } else if (strcmp(arg, "-o") == 0 && has_value) {
+            out_path = argv[++i];
+        } else if (strcmp(arg, "-b") == 0 && has_value) {
+            baseline_path = argv[++i];
+        } else if (strcmp(arg, "--threshold") == 0 && has_value) {
+            threshold = SDL_atof(argv[++i]);
+        } else if (strcmp(arg, "-t") == 0 && has_value) {
+            min_ms = SDL_atoi(argv[++i]);
+        } else if (strcmp(arg, "--perf") == 0) {
+            bench_state.perf = true;
+        } else if (strcmp(arg, "--soak") == 0 && has_value) {
+            soak_seconds = SDL_atoi(argv[++i]);
+        } else if (strcmp(arg, "-n") == 0 && has_value) {
+            bench_state.frames = SDL_atoi(argv[++i]);
+        } else {
+            ERROR("Invalid argument %s", arg);
+            print_usage();
+            return 1;
+        }
+    }
+    if (min_ms < 0 || bench_state.frames <= 0) {
+        ERROR("Invalid benchmark length");
+        return 1;
+    }
+    bench_state.min_ns = (Uint64)min_ms * SDL_NS_PER_MS;
+
+    SDL_Surface *synthetic[SYNTHETIC_FRAMES] = {0};
+    SDL_Surface *file_frames[MAX_FILE_FRAMES] = {0};
+    int file_count = 0;
+    bool failed = false;
+    for (int i = 0; i < SYNTHETIC_FRAMES; i++) {
+        synthetic[i] = make_synthetic(i);
+        if (synthetic[i] == NULL) failed = true;
+    }
+    if (in_path) {
+        file_count = load_y4m(in_path, file_frames);
+        if (file_count == 0) failed = true;
+    }
+
+    // headless, the software renderer draws into a surface big enough for any aspect
+    SDL_Surface *canvas = SDL_CreateSurface(OUTPUT_WIDTH, OUTPUT_WIDTH, SDL_PIXELFORMAT_XRGB8888);
+    bench_state.renderer = canvas ? SDL_CreateSoftwareRenderer(canvas) : NULL;
+    bench_state.samples = malloc(MAX_SAMPLES * sizeof(Uint64));
+    if (bench_state.renderer == NULL || bench_state.samples == NULL) {
+        ERROR("Failed to create software renderer\n%s", SDL_GetError());
+        failed = true;
+    } else {
+        bench_state.ascii = ascii_create(bench_state.renderer, OUTPUT_WIDTH / DEFAULT_RES, table_file);
+        if (bench_state.ascii == NULL) failed = true;
+    }
+
+    // a scalar build measures different kernels, say which ran
+    SDL_Log("Compute kernels built with %s", ascii_simd());
+
+    // counters follow this thread, the software renderer draws on it too
+    if (bench_state.perf && !perf_counters_open()) {
+        SDL_Log("Benchmarking without hardware counters");
+        bench_state.perf = false;
+    }
+
+    // a soak replaces the benchmarks, on the file frames if there are any
+    bool soaking = soak_seconds > 0;
+    if (!failed && soaking) {
+        SDL_Surface **frames = file_count ? file_frames : synthetic;
+        failed = !soak(frames, file_count ? file_count : SYNTHETIC_FRAMES, (Uint64)soak_seconds * SDL_NS_PER_SECOND);
+    }
+    if (!failed && !soaking) failed = !bench_source("synthetic", synthetic, SYNTHETIC_FRAMES, true);
+    if (!failed && !soaking && file_count) failed = !bench_source("file", file_frames, file_count, false);
+
+    int regressions = 0;
+    if (!failed && !soaking && baseline_path) {
+        regressions = compare_baseline(baseline_path, threshold);
+        if (regressions < 0) failed = true;
+    }
+    if (!failed && !soaking) {
+        FILE *out = out_path ? fopen(out_path, "w") : stdout;
+        if (out == NULL || !write_json(out)) {
+            ERROR("Couldn't write %s", out_path ? out_path : "results");
+            failed = true;
+        }
+        if (out && out != stdout) fclose(out);
+    }
+
+    // cleanup
+    for (int i = 0; i < SYNTHETIC_FRAMES; i++) SDL_DestroySurface(synthetic[i]);
+    for (int i = 0; i < file_count; i++) SDL_DestroySurface(file_frames[i]);
+    perf_counters_close();
+    ascii_destroy(bench_state.ascii);
+    if (bench_state.renderer) SDL_DestroyRenderer(bench_state.renderer);
+    SDL_DestroySurface(canvas);
+    free(bench_state.samples);
+    free(bench_state.results);
+    SDL_Quit();
+
+    return failed || regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/* Benchmark mode: j-ascii bench [options]
+   times the pipeline stages on their own and end to end, headless through
+   the software renderer, and writes median/p99/fps as JSON. With a saved
+   baseline every result is compared and regressions fail the run.
+   argv starts after the "bench" argument.
+*/
+int bench_main(int argc, char *argv[]);
+
+#endif
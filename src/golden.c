@@ -0,0 +1,419 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL.h>
+
+#include "ascii.h"
+#include "golden.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+#define IMAGE_W 320
+#define IMAGE_H 240
+#define IMAGE_COUNT 4
+// cell size of every rendered case, also the font size
+#define CELL_SIZE 8
+// thumbnails are THUMB x THUMB block means of 3 channels
+#define THUMB 8
+#define THUMB_BYTES (THUMB * THUMB * 3)
+#define MAX_TOLERANCES 16
+#define MAX_LINE 1024
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+/* one output, the hash has to match exactly unless a tolerance applies,
+   then the thumbnails may differ by up to the tolerance per block
+*/
+typedef struct {
+    char name[64];
+    Uint64 hash;
+    Uint8 thumb[THUMB_BYTES];
+} GoldenEntry;
+
+typedef struct {
+    const char *prefix;
+    int value;
+} Tolerance;
+
+struct {
+    AsciiContext *ascii;
+    SDL_Renderer *renderer;
+    SDL_Surface *canvas;
+
+    GoldenEntry *entries;
+    int entry_count;
+    int entry_capacity;
+    Tolerance tolerances[MAX_TOLERANCES];
+    int tolerance_count;
+} golden_state = {0};
+
+static const char *image_names[IMAGE_COUNT] = {"gradient", "bars", "checker", "noise"};
+
+//---Images---
+
+static Uint32 xorshift(Uint32 *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static void fill_image(SDL_Surface *s, int image) {
+    static const Uint8 bars[8][3] = {
+        {235, 235, 235}, {235, 235, 16}, {16, 235, 235}, {16, 235, 16},
+        {235, 16, 235}, {235, 16, 16}, {16, 16, 235}, {16, 16, 16},
+    };
+    Uint32 seed = 0x1234567;
+    for (int y = 0; y < s->h; y++) {
+        Uint8 *p = (Uint8 *)s->pixels + y * s->pitch;
+        for (int x = 0; x < s->w; x++, p += 3) {
+            switch (image) {
+                case 0:
+                    p[0] = x * 255 / (s->w - 1);
+                    p[1] = y * 255 / (s->h - 1);
+                    p[2] = 128;
+                break;
+                case 1: {
+                    // color bars over a gray ramp
+                    const Uint8 *bar = bars[x * 8 / s->w];
+                    Uint8 ramp = x * 255 / (s->w - 1);
+                    p[0] = y < s->h / 2 ? bar[0] : ramp;
+                    p[1] = y < s->h / 2 ? bar[1] : ramp;
+                    p[2] = y < s->h / 2 ? bar[2] : ramp;
+                }
+                break;
+                case 2: {
+                    bool on = ((x / 8) ^ (y / 8)) & 1;
+                    p[0] = on ? 235 : 16;
+                    p[1] = on ? 200 : 40;
+                    p[2] = on ? 64 : 16;
+                }
+                break;
+                default: {
+                    Uint32 v = xorshift(&seed);
+                    p[0] = v;
+                    p[1] = v >> 8;
+                    p[2] = v >> 16;
+                }
+                break;
+            }
+        }
+    }
+}
+
+//---Recording---
+
+static GoldenEntry *add_entry(const char *name) {
+    if (golden_state.entry_count == golden_state.entry_capacity) {
+        int capacity = golden_state.entry_capacity ? golden_state.entry_capacity * 2 : 64;
+        GoldenEntry *entries = realloc(golden_state.entries, capacity * sizeof(GoldenEntry));
+        if (entries == NULL) return NULL;
+        golden_state.entries = entries;
+        golden_state.entry_capacity = capacity;
+    }
+    GoldenEntry *e = &golden_state.entries[golden_state.entry_count++];
+    SDL_zerop(e);
+    SDL_strlcpy(e->name, name, sizeof(e->name));
+    return e;
+}
+
+// hash and thumbnail of the first three bytes of every pixel in w x h
+static bool record_pixels(const char *name, SDL_Surface *s, int w, int h, bool hash) {
+    GoldenEntry *e = add_entry(name);
+    if (e == NULL) return false;
+    int bpp = SDL_BYTESPERPIXEL(s->format);
+    if (hash) {
+        e->hash = FNV_OFFSET;
+        for (int y = 0; y < h; y++) {
+            Uint8 *p = (Uint8 *)s->pixels + y * s->pitch;
+            for (int x = 0; x < w; x++, p += bpp) {
+                for (int c = 0; c < 3; c++) e->hash = (e->hash ^ p[c]) * FNV_PRIME;
+            }
+        }
+    }
+
+    for (int ty = 0; ty < THUMB; ty++) {
+        int y0 = ty * h / THUMB, y1 = (ty + 1) * h / THUMB;
+        for (int tx = 0; tx < THUMB; tx++) {
+            int x0 = tx * w / THUMB, x1 = (tx + 1) * w / THUMB;
+            Uint64 sum[3] = {0};
+            for (int y = y0; y < y1; y++) {
+                Uint8 *p = (Uint8 *)s->pixels + y * s->pitch + x0 * bpp;
+                for (int x = x0; x < x1; x++, p += bpp) {
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                }
+            }
+            int n = SDL_max((x1 - x0) * (y1 - y0), 1);
+            for (int c = 0; c < 3; c++) e->thumb[(ty * THUMB + tx) * 3 + c] = sum[c] / n;
+        }
+    }
+    return true;
+}
+
+// cells are hashed as they are, the thumbnail shows glyph, color and background brightness
+static bool record_grid(const char *name, AsciiGrid *grid, int table_len) {
+    SDL_Surface *view = SDL_CreateSurface(grid->w, grid->h, SDL_PIXELFORMAT_RGB24);
+    if (view == NULL) return false;
+    for (int y = 0; y < grid->h; y++) {
+        Uint8 *p = (Uint8 *)view->pixels + y * view->pitch;
+        for (int x = 0; x < grid->w; x++, p += 3) {
+            AsciiCell cell = grid->cells[y * grid->w + x];
+            p[0] = cell.glyph * 255 / SDL_max(table_len - 1, 1);
+            p[1] = (54 * cell.r + 183 * cell.g + 19 * cell.b) >> 8;
+            p[2] = (54 * cell.bg_r + 183 * cell.bg_g + 19 * cell.bg_b) >> 8;
+        }
+    }
+    bool ok = record_pixels(name, view, grid->w, grid->h, false);
+    SDL_DestroySurface(view);
+    if (!ok) return false;
+
+    GoldenEntry *e = &golden_state.entries[golden_state.entry_count - 1];
+    e->hash = FNV_OFFSET;
+    const Uint8 *p = (const Uint8 *)grid->cells;
+    for (size_t i = 0; i < (size_t)grid->w * grid->h * sizeof(AsciiCell); i++) e->hash = (e->hash ^ p[i]) * FNV_PRIME;
+    return true;
+}
+
+// every image at two grid sizes through every mode, with the default table
+static bool render_cases() {
+    SDL_Surface *image = SDL_CreateSurface(IMAGE_W, IMAGE_H, SDL_PIXELFORMAT_RGB24);
+    if (image == NULL) return false;
+    static const int sizes[] = {LIMIT_LOWER, DEFAULT_RES};
+    bool ok = true;
+    for (int i = 0; ok && i < IMAGE_COUNT; i++) {
+        fill_image(image, i);
+        for (int k = 0; ok && k < (int)SDL_arraysize(sizes); k++) {
+            int cols = sizes[k];
+            int rows = cols * IMAGE_H / IMAGE_W;
+            SDL_FRect rect = {0, 0, cols * CELL_SIZE, rows * CELL_SIZE};
+            for (int mode = 0; ok && mode < ASCII_MODE_COUNT; mode++) {
+                int sx, sy;
+                ascii_mode_scale(mode, &sx, &sy);
+                int table = ascii_mode_table(golden_state.ascii, mode, 0);
+                int table_len = 0;
+                ascii_get_table(golden_state.ascii, table, &table_len);
+
+                SDL_Surface *frame = SDL_CreateSurface(cols * sx, rows * sy, SDL_PIXELFORMAT_RGB24);
+                SDL_Surface *out = SDL_CreateSurface(rect.w, rect.h, SDL_PIXELFORMAT_RGB24);
+                AsciiGrid grid = {0};
+                ok = frame && out && ascii_grid_resize(&grid, cols, rows) &&
+                     SDL_BlitSurfaceScaled(image, NULL, frame, NULL, SDL_SCALEMODE_NEAREST) &&
+                     ascii_bake_glyphs(golden_state.ascii, table);
+
+                char name[64];
+                const char *suffix = image_names[i];
+                if (ok) {
+                    ascii_compute_mode(golden_state.ascii, mode, &grid, frame, 0);
+                    SDL_snprintf(name, sizeof(name), "grid/%s/%s/%dx%d", ascii_mode_name(mode), suffix, cols, rows);
+                    ok = record_grid(name, &grid, table_len);
+                }
+                if (ok) {
+                    ascii_raster(golden_state.ascii, out, &grid);
+                    SDL_snprintf(name, sizeof(name), "raster/%s/%s/%dx%d", ascii_mode_name(mode), suffix, cols, rows);
+                    ok = record_pixels(name, out, out->w, out->h, true);
+                }
+                if (ok) {
+                    ascii_draw(golden_state.ascii, &rect, &grid);
+                    SDL_FlushRenderer(golden_state.renderer);
+                    SDL_snprintf(name, sizeof(name), "draw/%s/%s/%dx%d", ascii_mode_name(mode), suffix, cols, rows);
+                    ok = record_pixels(name, golden_state.canvas, rect.w, rect.h, true);
+                }
+                if (ok && mode == ASCII_MODE_TABLE) {
+                    ascii_render(golden_state.ascii, &rect, frame, 0);
+                    SDL_FlushRenderer(golden_state.renderer);
+                    SDL_snprintf(name, sizeof(name), "render/%s/%dx%d", suffix, cols, rows);
+                    ok = record_pixels(name, golden_state.canvas, rect.w, rect.h, true);
+                }
+
+                SDL_DestroySurface(frame);
+                SDL_DestroySurface(out);
+                ascii_grid_free(&grid);
+            }
+        }
+    }
+    SDL_DestroySurface(image);
+    return ok;
+}
+
+//---Golden file---
+
+static bool write_golden(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        ERROR("Couldn't open %s", path);
+        return false;
+    }
+    fprintf(out, "# j-ascii golden outputs: name hash thumbnail\n");
+    for (int i = 0; i < golden_state.entry_count; i++) {
+        GoldenEntry *e = &golden_state.entries[i];
+        fprintf(out, "%s %016llx ", e->name, (unsigned long long)e->hash);
+        for (int k = 0; k < THUMB_BYTES; k++) fprintf(out, "%02x", e->thumb[k]);
+        fputc('\n', out);
+    }
+    bool ok = fclose(out) == 0;
+    if (ok) SDL_Log("Wrote %d golden outputs to %s", golden_state.entry_count, path);
+    return ok;
+}
+
+static bool parse_entry(char *line, GoldenEntry *e) {
+    unsigned long long hash;
+    char hex[THUMB_BYTES * 2 + 1];
+    if (sscanf(line, "%63s %16llx %384s", e->name, &hash, hex) != 3 || SDL_strlen(hex) != THUMB_BYTES * 2)
+        return false;
+    e->hash = hash;
+    for (int k = 0; k < THUMB_BYTES; k++) {
+        unsigned v;
+        if (sscanf(hex + k * 2, "%2x", &v) != 1) return false;
+        e->thumb[k] = v;
+    }
+    return true;
+}
+
+// the longest matching prefix wins, exact without any
+static int tolerance_for(const char *name) {
+    int value = 0;
+    size_t best = 0;
+    for (int i = 0; i < golden_state.tolerance_count; i++) {
+        Tolerance *t = &golden_state.tolerances[i];
+        size_t len = SDL_strlen(t->prefix);
+        if (len >= best && SDL_strncmp(name, t->prefix, len) == 0) {
+            value = t->value;
+            best = len;
+        }
+    }
+    return value;
+}
+
+// returns failed outputs or -1 if the golden file can't be read
+static int compare_golden(const char *path) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        ERROR("Couldn't open %s, -u creates it", path);
+        return -1;
+    }
+
+    bool *seen = calloc(golden_state.entry_count, sizeof(bool));
+    int failed = 0, exact = 0, close = 0;
+    char line[MAX_LINE];
+    while (seen && fgets(line, sizeof(line), in)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        GoldenEntry golden;
+        if (!parse_entry(line, &golden)) {
+            ERROR("Bad golden line %s", line);
+            failed++;
+            continue;
+        }
+        GoldenEntry *e = NULL;
+        for (int i = 0; i < golden_state.entry_count && e == NULL; i++) {
+            if (SDL_strcmp(golden_state.entries[i].name, golden.name) == 0) {
+                e = &golden_state.entries[i];
+                seen[i] = true;
+            }
+        }
+        if (e == NULL) {
+            ERROR("%s is no longer rendered", golden.name);
+            failed++;
+            continue;
+        }
+        if (e->hash == golden.hash) {
+            exact++;
+            continue;
+        }
+
+        int diff = 0;
+        for (int k = 0; k < THUMB_BYTES; k++) diff = SDL_max(diff, SDL_abs(e->thumb[k] - golden.thumb[k]));
+        int tolerance = tolerance_for(e->name);
+        if (tolerance > 0 && diff <= tolerance) {
+            SDL_Log("%-36s differs, thumbnail off by %d, within %d", e->name, diff, tolerance);
+            close++;
+        } else {
+            ERROR("%-36s differs, thumbnail off by %d", e->name, diff);
+            failed++;
+        }
+    }
+    fclose(in);
+
+    for (int i = 0; seen && i < golden_state.entry_count; i++) {
+        if (seen[i]) continue;
+        ERROR("%s has no golden output, -u adds it", golden_state.entries[i].name);
+        failed++;
+    }
+    free(seen);
+    SDL_Log("%d exact, %d within tolerance, %d failed", exact, close, failed);
+    return failed;
+}
+
+static void print_usage() {
+    SDL_Log("Usage: j-ascii golden [options] <golden.txt>");
+    SDL_Log("  -u                        write the current outputs as the golden file");
+    SDL_Log("  --tolerance [prefix=]<n>  outputs starting with prefix may differ by n per");
+    SDL_Log("                            thumbnail block, e.g. raster/=2, can be repeated");
+}
+
+int golden_main(int argc, char *argv[]) {
+    char *path = NULL;
+    bool update = false;
+
+    // args
+    for (int i = 0; i < argc; i++) {
+        char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_usage();
+            return 0;
+        } else if (strcmp(arg, "-u") == 0) {
+            update = true;
+        } else if (strcmp(arg, "--tolerance") == 0 && has_value) {
+            if (golden_state.tolerance_count == MAX_TOLERANCES) {
+                ERROR("Too many tolerances");
+                return 1;
+            }
+            char *value = argv[++i];
+            char *eq = SDL_strchr(value, '=');
+            Tolerance *t = &golden_state.tolerances[golden_state.tolerance_count++];
+            t->prefix = eq ? value : "";
+            t->value = SDL_atoi(eq ? eq + 1 : value);
+            if (eq) *eq = '\0';
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            ERROR("Invalid argument %s", arg);
+            print_usage();
+            return 1;
+        } else if (path == NULL) {
+            path = arg;
+        } else {
+            ERROR("Unexpected argument %s", arg);
+            return 1;
+        }
+    }
+    if (path == NULL) {
+        print_usage();
+        return 1;
+    }
+
+    // headless, the largest case fits the canvas
+    int canvas_w = DEFAULT_RES * CELL_SIZE;
+    golden_state.canvas = SDL_CreateSurface(canvas_w, canvas_w * IMAGE_H / IMAGE_W, SDL_PIXELFORMAT_XRGB8888);
+    golden_state.renderer = golden_state.canvas ? SDL_CreateSoftwareRenderer(golden_state.canvas) : NULL;
+    if (golden_state.renderer) golden_state.ascii = ascii_create(golden_state.renderer, CELL_SIZE, NULL);
+
+    int failed = 0;
+    if (golden_state.ascii == NULL || !render_cases()) {
+        ERROR("Failed to render golden cases\n%s", SDL_GetError());
+        failed = 1;
+    } else if (update) {
+        failed = !write_golden(path);
+    } else {
+        failed = compare_golden(path);
+    }
+
+    // cleanup
+    ascii_destroy(golden_state.ascii);
+    if (golden_state.renderer) SDL_DestroyRenderer(golden_state.renderer);
+    SDL_DestroySurface(golden_state.canvas);
+    free(golden_state.entries);
+    SDL_Quit();
+
+    return failed != 0 ? 1 : 0;
+}
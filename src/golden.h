@@ -0,0 +1,12 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+/* Golden output mode: j-ascii golden [options] <golden.txt>
+   renders fixed images through the compute stage, ascii_raster,
+   ascii_draw and ascii_render on the software renderer and compares
+   hashes of the grids and pixels against a golden file, -u rewrites it.
+   argv starts after the "golden" argument.
+*/
+int golden_main(int argc, char *argv[]);
+
+#endif
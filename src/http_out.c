@@ -0,0 +1,463 @@
+#include <SDL3/SDL.h>
+
+#include "http_out.h"
+#include "stream.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 64
+#define REQUEST_MAX 4096
+// bytes a client may have queued before it is considered behind
+#define CLIENT_MAX_BACKLOG (4 * 1024 * 1024)
+// frames between forced keyframes
+#define KEYFRAME_INTERVAL 120
+
+static const char page[] =
+    "<!DOCTYPE html><html><head><title>J-Ascii2</title>"
+    "<style>body{margin:0;background:#181818;overflow:hidden}</style></head>"
+    "<body><canvas id=c></canvas><script>\n"
+    "const c=document.getElementById('c'),x=c.getContext('2d');\n"
+    "let w=0,h=0,t='',cells=null,dirty=false;\n"
+    "const b64=s=>Uint8Array.from(atob(s),ch=>ch.charCodeAt(0));\n"
+    "const es=new EventSource('/events');\n"
+    "es.addEventListener('key',e=>{const p=e.data.split(' ');w=+p[0];h=+p[1];\n"
+    "  t=Array.from(new TextDecoder().decode(b64(p[2])));cells=b64(p[3]);dirty=true;});\n"
+    "es.addEventListener('delta',e=>{if(!cells)return;const d=b64(e.data),v=new DataView(d.buffer);\n"
+    "  for(let i=0;i+12<=d.length;i+=12)cells.set(d.subarray(i+4,i+12),v.getUint32(i,true)*8);dirty=true;});\n"
+    "function draw(){requestAnimationFrame(draw);if(!dirty||!w)return;dirty=false;\n"
+    "  c.width=innerWidth;c.height=innerHeight;const s=Math.max(1,Math.floor(Math.min(c.width/w,c.height/h)));\n"
+    "  x.fillStyle='#181818';x.fillRect(0,0,c.width,c.height);x.font=s+'px monospace';x.textBaseline='top';\n"
+    "  for(let y=0;y<h;y++)for(let i=0;i<w;i++){const k=(y*w+i)*8;\n"
+    "    if(cells[k+5]!=24||cells[k+6]!=24||cells[k+7]!=24){\n"
+    "      x.fillStyle=`rgb(${cells[k+5]},${cells[k+6]},${cells[k+7]})`;x.fillRect(i*s,y*s,s,s);}\n"
+    "    x.fillStyle=`rgb(${cells[k+2]},${cells[k+3]},${cells[k+4]})`;x.fillText(t[cells[k]|cells[k+1]<<8]||' ',i*s,y*s);}}\n"
+    "draw();\n"
+    "</script></body></html>";
+
+typedef struct Client {
+    int fd;
+    bool streaming;
+    bool close_after_send;
+    bool waiting_key; // skip deltas until the next keyframe
+    char request[REQUEST_MAX];
+    int request_len;
+
+    StreamQueue queue;
+    struct Client *next;
+} Client;
+
+struct {
+    bool running;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    SDL_Thread *thread;
+    SDL_AtomicInt quit;
+    SDL_AtomicInt stream_count;
+    SDL_AtomicInt want_key;
+
+    // handoff from the publishing thread
+    SDL_Mutex *lock;
+    StreamMessage *pending[STREAM_QUEUE_LEN];
+    int pending_count;
+
+    // server thread only
+    Client *clients;
+
+    // publishing thread only
+    AsciiGrid prev;
+    AsciiContext *prev_ctx; // a reloaded context can change the table behind the same index
+    int frames_since_key;
+    char *scratch;
+    size_t scratch_size;
+} http_state = {0};
+
+static const char b64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static size_t base64_encode(char *dst, const Uint8 *src, size_t len) {
+    char *p = dst;
+    size_t i = 0;
+    for (; i + 2 < len; i += 3) {
+        Uint32 v = src[i] << 16 | src[i + 1] << 8 | src[i + 2];
+        *p++ = b64_chars[v >> 18];
+        *p++ = b64_chars[(v >> 12) & 63];
+        *p++ = b64_chars[(v >> 6) & 63];
+        *p++ = b64_chars[v & 63];
+    }
+    if (i < len) {
+        Uint32 v = src[i] << 16 | (i + 1 < len ? src[i + 1] << 8 : 0);
+        *p++ = b64_chars[v >> 18];
+        *p++ = b64_chars[(v >> 12) & 63];
+        *p++ = i + 1 < len ? b64_chars[(v >> 6) & 63] : '=';
+        *p++ = '=';
+    }
+    return p - dst;
+}
+
+//---Client io (server thread)---
+
+static void client_update_events(Client *client) {
+    struct epoll_event ev = {
+        .events = EPOLLIN | (client->queue.count ? EPOLLOUT : 0),
+        .data.ptr = client,
+    };
+    epoll_ctl(http_state.epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
+}
+
+static void client_push(Client *client, StreamMessage *msg) {
+    if (client->waiting_key && !msg->key) return;
+    if (!stream_queue_push(&client->queue, msg, CLIENT_MAX_BACKLOG)) {
+        // fell behind, drop everything and resume at the next keyframe
+        stream_queue_clear(&client->queue, true);
+        client->waiting_key = true;
+        SDL_SetAtomicInt(&http_state.want_key, 1);
+        if (!msg->key || !stream_queue_push(&client->queue, msg, CLIENT_MAX_BACKLOG)) return;
+    }
+    client->waiting_key = false;
+}
+
+static void client_close(Client *client) {
+    Client **it = &http_state.clients;
+    while (*it != client) it = &(*it)->next;
+    *it = client->next;
+
+    if (client->streaming) SDL_AddAtomicInt(&http_state.stream_count, -1);
+    stream_queue_clear(&client->queue, false);
+    close(client->fd);
+    SDL_free(client);
+}
+
+// returns false if the client should be closed
+static bool client_flush(Client *client) {
+    if (!stream_queue_flush(&client->queue, client->fd)) return false;
+    return client->queue.count > 0 || !client->close_after_send;
+}
+
+static void client_respond(Client *client, const char *status, const char *type, const char *body, size_t len) {
+    char header[256];
+    int header_len = SDL_snprintf(header, sizeof(header),
+                                  "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                                  "Connection: close\r\n\r\n", status, type, len);
+    StreamMessage *msg = stream_message_create(NULL, header_len + len, true);
+    if (msg == NULL) return;
+    SDL_memcpy(msg->data, header, header_len);
+    SDL_memcpy(msg->data + header_len, body, len);
+    client_push(client, msg);
+    stream_message_unref(msg);
+    client->close_after_send = true;
+}
+
+// returns false if the client should be closed
+static bool client_read(Client *client) {
+    ssize_t n = recv(client->fd, client->request + client->request_len,
+                     REQUEST_MAX - 1 - client->request_len, 0);
+    if (n == 0) return false;
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+    // streams don't send anything else we care about
+    if (client->streaming || client->close_after_send) return true;
+
+    client->request_len += n;
+    client->request[client->request_len] = '\0';
+    if (SDL_strstr(client->request, "\r\n\r\n") == NULL) {
+        return client->request_len < REQUEST_MAX - 1;
+    }
+
+    if (SDL_strncmp(client->request, "GET /events", 11) == 0) {
+        static const char sse_header[] =
+            "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+            "Connection: keep-alive\r\nAccess-Control-Allow-Origin: *\r\n\r\n";
+        StreamMessage *msg = stream_message_create(sse_header, sizeof(sse_header) - 1, true);
+        if (msg == NULL) return false;
+        client_push(client, msg);
+        stream_message_unref(msg);
+        client->streaming = true;
+        client->waiting_key = true;
+        SDL_AddAtomicInt(&http_state.stream_count, 1);
+        SDL_SetAtomicInt(&http_state.want_key, 1);
+    } else if (SDL_strncmp(client->request, "GET / ", 6) == 0) {
+        client_respond(client, "200 OK", "text/html", page, sizeof(page) - 1);
+    } else {
+        client_respond(client, "404 Not Found", "text/plain", "not found\n", 10);
+    }
+    return true;
+}
+
+static void accept_clients() {
+    while (true) {
+        int fd = accept(http_state.listen_fd, NULL, NULL);
+        if (fd < 0) return;
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        Client *client = SDL_calloc(1, sizeof(Client));
+        if (client == NULL) {
+            close(fd);
+            return;
+        }
+        client->fd = fd;
+        client->next = http_state.clients;
+        http_state.clients = client;
+
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = client};
+        epoll_ctl(http_state.epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+// move published messages onto every stream
+static void fan_out() {
+    Uint64 count;
+    read(http_state.wake_fd, &count, sizeof(count));
+
+    StreamMessage *pending[STREAM_QUEUE_LEN];
+    SDL_LockMutex(http_state.lock);
+    int pending_count = http_state.pending_count;
+    SDL_memcpy(pending, http_state.pending, pending_count * sizeof(StreamMessage *));
+    http_state.pending_count = 0;
+    SDL_UnlockMutex(http_state.lock);
+
+    for (int i = 0; i < pending_count; i++) {
+        for (Client *client = http_state.clients; client; client = client->next) {
+            if (client->streaming) client_push(client, pending[i]);
+        }
+        stream_message_unref(pending[i]);
+    }
+    for (Client *client = http_state.clients; client; client = client->next) {
+        if (client->queue.count) client_update_events(client);
+    }
+}
+
+static int server_thread(void *data) {
+    (void)data;
+    struct epoll_event events[MAX_EVENTS];
+    while (!SDL_GetAtomicInt(&http_state.quit)) {
+        int n = epoll_wait(http_state.epoll_fd, events, MAX_EVENTS, 500);
+        for (int i = 0; i < n; i++) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == &http_state.listen_fd) {
+                accept_clients();
+                continue;
+            }
+            if (ptr == &http_state.wake_fd) {
+                fan_out();
+                continue;
+            }
+
+            Client *client = ptr;
+            bool keep = true;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) keep = false;
+            if (keep && (events[i].events & EPOLLIN)) keep = client_read(client);
+            if (keep && client->queue.count) keep = client_flush(client);
+            if (keep) client_update_events(client);
+            else client_close(client);
+        }
+    }
+
+    while (http_state.clients) client_close(http_state.clients);
+    return 0;
+}
+
+// sockets of a failed start, the ones not created yet are -1
+static void close_fds() {
+    close(http_state.listen_fd);
+    if (http_state.epoll_fd >= 0) close(http_state.epoll_fd);
+    if (http_state.wake_fd >= 0) close(http_state.wake_fd);
+}
+
+bool http_out_start(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ERROR("Couldn't create http socket");
+        return false;
+    }
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        ERROR("Couldn't listen on port %d", port);
+        close(fd);
+        return false;
+    }
+
+    http_state.listen_fd = fd;
+    http_state.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    http_state.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &http_state.listen_fd};
+    struct epoll_event wake = {.events = EPOLLIN, .data.ptr = &http_state.wake_fd};
+    if (http_state.epoll_fd < 0 || http_state.wake_fd < 0 ||
+        epoll_ctl(http_state.epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0 ||
+        epoll_ctl(http_state.epoll_fd, EPOLL_CTL_ADD, http_state.wake_fd, &wake) < 0) {
+        ERROR("Couldn't set up http polling");
+        close_fds();
+        return false;
+    }
+
+    http_state.lock = SDL_CreateMutex();
+    if (http_state.lock == NULL) {
+        ERROR("Couldn't create http lock\n%s", SDL_GetError());
+        close_fds();
+        return false;
+    }
+    SDL_SetAtomicInt(&http_state.quit, 0);
+    http_state.thread = SDL_CreateThread(server_thread, "http", NULL);
+    if (http_state.thread == NULL) {
+        ERROR("Couldn't create http thread\n%s", SDL_GetError());
+        SDL_DestroyMutex(http_state.lock);
+        close_fds();
+        return false;
+    }
+    http_state.running = true;
+    SDL_Log("Serving ascii stream on http://127.0.0.1:%d", port);
+    return true;
+}
+
+static char *reserve_scratch(size_t size) {
+    if (size > http_state.scratch_size) {
+        char *scratch = SDL_realloc(http_state.scratch, size);
+        if (scratch == NULL) return NULL;
+        http_state.scratch = scratch;
+        http_state.scratch_size = size;
+    }
+    return http_state.scratch;
+}
+
+static StreamMessage *encode_keyframe(AsciiContext *ctx, AsciiGrid *grid) {
+    size_t table_len;
+    const char *table = ascii_get_table_utf8(ctx, grid->table_index, &table_len);
+    size_t cells_size = grid->w * grid->h * sizeof(AsciiCell);
+    char *buf = reserve_scratch(64 + (table_len + cells_size) / 3 * 4 + 8);
+    if (buf == NULL) return NULL;
+
+    size_t len = SDL_snprintf(buf, 64, "event: key\ndata: %d %d ", grid->w, grid->h);
+    len += base64_encode(buf + len, (const Uint8 *)table, table_len);
+    buf[len++] = ' ';
+    len += base64_encode(buf + len, (const Uint8 *)grid->cells, cells_size);
+    SDL_memcpy(buf + len, "\n\n", 2);
+    return stream_message_create(buf, len + 2, true);
+}
+
+#define DELTA_SIZE (4 + sizeof(AsciiCell))
+
+// changed cells as (u32 index, cell) pairs, NULL if a keyframe is cheaper
+static StreamMessage *encode_delta(AsciiGrid *grid) {
+    int count = grid->w * grid->h;
+    Uint8 *changes = (Uint8 *)reserve_scratch(count * DELTA_SIZE * 2 + 64);
+    if (changes == NULL) return NULL;
+
+    int changed = 0;
+    AsciiCell *prev = http_state.prev.cells;
+    AsciiCell *cells = grid->cells;
+    for (int i = 0; i < count; i++) {
+        if (SDL_memcmp(&prev[i], &cells[i], sizeof(AsciiCell)) == 0) continue;
+        if (++changed > count / 2) return NULL;
+        Uint8 *p = changes + (changed - 1) * DELTA_SIZE;
+        p[0] = i;
+        p[1] = i >> 8;
+        p[2] = i >> 16;
+        p[3] = i >> 24;
+        SDL_memcpy(p + 4, &cells[i], sizeof(AsciiCell));
+    }
+    if (changed == 0) return stream_message_create("", 0, false);
+
+    char *buf = (char *)changes + count * DELTA_SIZE;
+    size_t len = SDL_snprintf(buf, 64, "event: delta\ndata: ");
+    len += base64_encode(buf + len, changes, changed * DELTA_SIZE);
+    SDL_memcpy(buf + len, "\n\n", 2);
+    return stream_message_create(buf, len + 2, false);
+}
+
+void http_out_publish(AsciiContext *ctx, AsciiGrid *grid) {
+    if (!http_state.running) return;
+    // nothing to encode for
+    if (SDL_GetAtomicInt(&http_state.stream_count) == 0) {
+        http_state.prev.w = 0;
+        return;
+    }
+
+    AsciiGrid *prev = &http_state.prev;
+    bool key = SDL_SetAtomicInt(&http_state.want_key, 0) ||
+               prev->w != grid->w || prev->h != grid->h || prev->table_index != grid->table_index ||
+               http_state.prev_ctx != ctx || ++http_state.frames_since_key >= KEYFRAME_INTERVAL;
+    StreamMessage *msg = key ? NULL : encode_delta(grid);
+    if (msg == NULL) {
+        msg = encode_keyframe(ctx, grid);
+        http_state.frames_since_key = 0;
+    }
+
+    if (!ascii_grid_resize(prev, grid->w, grid->h)) prev->w = 0;
+    else {
+        prev->table_index = grid->table_index;
+        http_state.prev_ctx = ctx;
+        SDL_memcpy(prev->cells, grid->cells, grid->w * grid->h * sizeof(AsciiCell));
+    }
+    if (msg == NULL) return;
+    if (msg->len == 0) {
+        stream_message_unref(msg);
+        return;
+    }
+
+    SDL_LockMutex(http_state.lock);
+    if (http_state.pending_count < STREAM_QUEUE_LEN) {
+        http_state.pending[http_state.pending_count++] = msg;
+        msg = NULL;
+    }
+    SDL_UnlockMutex(http_state.lock);
+
+    if (msg) {
+        // server thread is stalled, clients resync on the next keyframe
+        stream_message_unref(msg);
+        SDL_SetAtomicInt(&http_state.want_key, 1);
+        return;
+    }
+    Uint64 one = 1;
+    write(http_state.wake_fd, &one, sizeof(one));
+}
+
+void http_out_stop() {
+    if (!http_state.running) return;
+    SDL_SetAtomicInt(&http_state.quit, 1);
+    Uint64 one = 1;
+    write(http_state.wake_fd, &one, sizeof(one));
+    SDL_WaitThread(http_state.thread, NULL);
+
+    for (int i = 0; i < http_state.pending_count; i++) stream_message_unref(http_state.pending[i]);
+    http_state.pending_count = 0;
+    close(http_state.listen_fd);
+    close(http_state.wake_fd);
+    close(http_state.epoll_fd);
+    SDL_DestroyMutex(http_state.lock);
+    ascii_grid_free(&http_state.prev);
+    SDL_free(http_state.scratch);
+    http_state.scratch = NULL;
+    http_state.scratch_size = 0;
+    http_state.running = false;
+}
+
+#else
+
+bool http_out_start(int port) {
+    (void)port;
+    ERROR("The http server is not supported on this platform");
+    return false;
+}
+
+void http_out_publish(AsciiContext *ctx, AsciiGrid *grid) {
+    (void)ctx;
+    (void)grid;
+}
+
+void http_out_stop() {}
+
+#endif
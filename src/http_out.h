@@ -0,0 +1,14 @@
+#ifndef HTTP_OUT_H
+#define HTTP_OUT_H
+#include "ascii.h"
+
+/* Embedded http server streaming the ascii grid to browsers.
+   GET / serves a viewer page, GET /events is a Server-Sent Events stream
+   of keyframes and cell deltas. Frames are encoded once on the calling
+   thread and shared by all clients, a single epoll thread does the io.
+*/
+bool http_out_start(int port);
+void http_out_publish(AsciiContext *ctx, AsciiGrid *grid);
+void http_out_stop();
+
+#endif
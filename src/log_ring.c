@@ -0,0 +1,180 @@
+#include <stdlib.h>
+
+#include "log_ring.h"
+
+#define RING_SIZE 1024
+#define TEXT_MAX 256
+#define WRITE_INTERVAL_MS 20
+// a message seen again within the window is only counted
+#define REPEAT_WINDOW_NS (5 * SDL_NS_PER_SECOND)
+#define REPEAT_SLOTS 32
+#define FNV_OFFSET 0x811c9dc5u
+#define FNV_PRIME 0x01000193u
+
+/* bounded queue with a sequence number per slot, any thread may push.
+   a slot is free for position p when seq == p and holds p once seq == p + 1
+*/
+typedef struct {
+    SDL_AtomicU32 seq;
+    int category;
+    SDL_LogPriority priority;
+    char text[TEXT_MAX];
+} LogRecord;
+
+typedef struct {
+    Uint32 hash;
+    Uint64 window_start;
+    int repeats; // held back in the current window
+    int category;
+    SDL_LogPriority priority;
+    char text[TEXT_MAX];
+} RepeatSlot;
+
+static struct {
+    bool running;
+    SDL_LogOutputFunction output;
+    void *output_data;
+    SDL_Thread *thread;
+    SDL_AtomicInt quit;
+    SDL_AtomicU32 head;
+    SDL_AtomicInt dropped;
+    LogRecord records[RING_SIZE];
+
+    // writer thread only, or whoever holds the flush lock
+    SDL_Mutex *flush_lock;
+    Uint32 tail;
+    RepeatSlot repeats[REPEAT_SLOTS];
+} log_state = {0};
+
+//---Producers---
+
+static void SDLCALL push(void *data, int category, SDL_LogPriority priority, const char *message) {
+    (void)data;
+    Uint32 pos = SDL_GetAtomicU32(&log_state.head);
+    LogRecord *r;
+    while (true) {
+        r = &log_state.records[pos % RING_SIZE];
+        int diff = (int)(SDL_GetAtomicU32(&r->seq) - pos);
+        if (diff == 0 && SDL_CompareAndSwapAtomicU32(&log_state.head, pos, pos + 1)) break;
+        if (diff < 0) {
+            // full, never wait on the writer
+            SDL_AddAtomicInt(&log_state.dropped, 1);
+            return;
+        }
+        pos = SDL_GetAtomicU32(&log_state.head);
+    }
+    r->category = category;
+    r->priority = priority;
+    SDL_strlcpy(r->text, message, TEXT_MAX);
+    SDL_SetAtomicU32(&r->seq, pos + 1);
+}
+
+//---Writer---
+
+static void write_repeats(RepeatSlot *slot, Uint64 now) {
+    if (slot->repeats == 0) return;
+    char text[TEXT_MAX + 64];
+    SDL_snprintf(text, sizeof(text), "%s (repeated %d times in %.1fs)", slot->text, slot->repeats,
+                 (now - slot->window_start) / 1e9);
+    log_state.output(log_state.output_data, slot->category, slot->priority, text);
+    slot->repeats = 0;
+}
+
+// false if the message repeats one written within the window
+static bool check_repeat(LogRecord *r, Uint64 now) {
+    Uint32 hash = FNV_OFFSET;
+    for (const char *p = r->text; *p; p++) hash = (hash ^ (Uint8)*p) * FNV_PRIME;
+
+    RepeatSlot *oldest = &log_state.repeats[0];
+    for (int i = 0; i < REPEAT_SLOTS; i++) {
+        RepeatSlot *slot = &log_state.repeats[i];
+        if (slot->hash == hash && slot->window_start && SDL_strcmp(slot->text, r->text) == 0) {
+            if (now - slot->window_start < REPEAT_WINDOW_NS) {
+                slot->repeats++;
+                return false;
+            }
+            // still repeating, the count stands in for the message
+            bool repeating = slot->repeats > 0;
+            slot->repeats += repeating;
+            write_repeats(slot, now);
+            slot->window_start = now;
+            return !repeating;
+        }
+        if (slot->window_start < oldest->window_start) oldest = slot;
+    }
+    write_repeats(oldest, now);
+    *oldest = (RepeatSlot){.hash = hash, .window_start = now, .category = r->category, .priority = r->priority};
+    SDL_strlcpy(oldest->text, r->text, TEXT_MAX);
+    return true;
+}
+
+static void flush() {
+    SDL_LockMutex(log_state.flush_lock);
+    Uint64 now = SDL_GetTicksNS();
+    while (true) {
+        LogRecord *r = &log_state.records[log_state.tail % RING_SIZE];
+        if (SDL_GetAtomicU32(&r->seq) != log_state.tail + 1) break;
+        if (check_repeat(r, now)) log_state.output(log_state.output_data, r->category, r->priority, r->text);
+        SDL_SetAtomicU32(&r->seq, log_state.tail + RING_SIZE);
+        log_state.tail++;
+    }
+    int dropped = SDL_SetAtomicInt(&log_state.dropped, 0);
+    if (dropped) {
+        char text[64];
+        SDL_snprintf(text, sizeof(text), "%d log messages dropped, the log ring was full", dropped);
+        log_state.output(log_state.output_data, SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN, text);
+    }
+    // a message that stopped repeating still reports its count
+    for (int i = 0; i < REPEAT_SLOTS; i++) {
+        RepeatSlot *slot = &log_state.repeats[i];
+        if (slot->repeats && now - slot->window_start >= REPEAT_WINDOW_NS) write_repeats(slot, now);
+    }
+    SDL_UnlockMutex(log_state.flush_lock);
+}
+
+static int writer_thread(void *data) {
+    (void)data;
+    while (!SDL_GetAtomicInt(&log_state.quit)) {
+        flush();
+        SDL_Delay(WRITE_INTERVAL_MS);
+    }
+    return 0;
+}
+
+// EXIT() and fatal paths leave through exit, nothing queued gets lost
+static void flush_at_exit() {
+    if (log_state.running) flush();
+}
+
+bool log_ring_start() {
+    if (log_state.running) return true;
+    for (Uint32 i = 0; i < RING_SIZE; i++) SDL_SetAtomicU32(&log_state.records[i].seq, i);
+    SDL_SetAtomicU32(&log_state.head, 0);
+    log_state.tail = 0;
+    log_state.flush_lock = SDL_CreateMutex();
+    if (log_state.flush_lock == NULL) return false;
+
+    SDL_GetLogOutputFunction(&log_state.output, &log_state.output_data);
+    SDL_SetAtomicInt(&log_state.quit, 0);
+    log_state.thread = SDL_CreateThread(writer_thread, "log", NULL);
+    if (log_state.thread == NULL) {
+        SDL_DestroyMutex(log_state.flush_lock);
+        return false;
+    }
+    static bool registered = false;
+    if (!registered) registered = atexit(flush_at_exit) == 0;
+    log_state.running = true;
+    SDL_SetLogOutputFunction(push, NULL);
+    return true;
+}
+
+void log_ring_stop() {
+    if (!log_state.running) return;
+    SDL_SetLogOutputFunction(log_state.output, log_state.output_data);
+    SDL_SetAtomicInt(&log_state.quit, 1);
+    SDL_WaitThread(log_state.thread, NULL);
+    flush();
+    for (int i = 0; i < REPEAT_SLOTS; i++) write_repeats(&log_state.repeats[i], SDL_GetTicksNS());
+    log_state.running = false;
+    SDL_DestroyMutex(log_state.flush_lock);
+}
@@ -0,0 +1,15 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+#include <SDL3/SDL.h>
+
+/* Takes over SDL's log output so SDL_Log never does io on the calling
+   thread. messages are copied into fixed size records of a lock free
+   ring and written by a background thread, which also holds back a
+   message repeated within a few seconds and reports how often it was.
+   a full ring drops messages instead of waiting.
+*/
+bool log_ring_start();
+// writes everything still queued, then restores SDL's output
+void log_ring_stop();
+
+#endif
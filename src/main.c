@@ -4,17 +4,32 @@
 #include <SDL3/SDL.h>
 #include <SDL3_ttf/SDL_ttf.h>
 
+#include "alloc_stats.h"
 #include "ascii.h"
+#include "bench.h"
+#include "golden.h"
+#include "http_out.h"
+#include "log_ring.h"
+#include "metrics.h"
+#include "quality.h"
+#include "record.h"
+#include "shm_out.h"
+#include "table_watch.h"
+#include "telnet_out.h"
+#include "trace.h"
+#include "transcode.h"
 
 #define SCALE_STEP 1.1f
-#define LIMIT_UPPER 240
-#define LIMIT_LOWER 16
+#define ZOOM_STEP 1.25f
+#define ZOOM_MAX 8.0f
+#define PAN_STEP 0.1f // of the view per key press
 
 #define WINDOW_WIDTH 1200
 #define WINDOW_HEIGHT 800
 
 #define BAR_WIDTH 150
 #define FRAME_TIME (1000.0f / 60.0f)
+#define IDLE_WAIT_MS 250 // longest sleep while nothing needs a frame, events wake it
 
 #define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
 #define EXIT(code) ({SDL_Quit(); exit(code);})
@@ -28,7 +43,13 @@ struct {
     SDL_FRect cam_rect;
     int ascii_table_index;
     int ascii_table_count;
+    AsciiMode mode;
+    AsciiView view; // part of the camera frame that is shown
+    bool fullscreen;
     SDL_Texture *fbo;
+    AsciiTarget target; // what fbo shows, only changed tiles are redrawn
+    SDL_Surface *frame; // camera frame scaled for the mode, kept between frames
+    AsciiGrid grid;
 
     Uint64 time_prev;
     Uint64 time_delta;
@@ -47,8 +68,38 @@ struct {
     SDL_CameraID *devices;
 } cam_state = {0};
 
+// the window is shown right away while fonts and camera load on threads
+struct {
+    Uint64 start;
+    char *table_file;
+
+    SDL_Thread *ascii_thread;
+    SDL_AtomicInt ascii_done;
+    AsciiContext *ascii;
+
+    SDL_Thread *camera_thread;
+    SDL_AtomicInt camera_done;
+    SDL_Semaphore *camera_signal; // posted once with camera_done, the ascii thread waits on it
+    SDL_CameraID *devices;
+    int dev_count;
+    SDL_Camera *camera;
+    SDL_CameraSpec spec;
+
+    bool first_frame;
+} startup = {0};
+
+// window not visible, only outputs that don't need it get frames
+struct {
+    bool hidden;
+    Uint64 hidden_since;
+    bool outputs; // shm, http or telnet were started
+    int release_after; // seconds hidden before the camera is closed, 0 keeps it
+    bool released;
+} idle = {0};
+
 SDL_Window *window;
 SDL_Renderer *renderer;
+AsciiContext *ascii;
 
 void update_window_title() {
     if (!cam_state.ready) {
@@ -63,15 +114,13 @@ void update_window_title() {
     SDL_SetWindowTitle(window, title);
 }
 
-bool open_camera(SDL_CameraID device) {
-    if (cam_state.camera != NULL) SDL_CloseCamera(cam_state.camera);
-
-    // select best format
+// open device with its highest fps format, doesn't touch any state so it can run on any thread
+SDL_Camera *open_best_format(SDL_CameraID device, SDL_CameraSpec *spec) {
     int format_count = 0;
     SDL_CameraSpec **formats = SDL_GetCameraSupportedFormats(device, &format_count);
     SDL_CameraSpec *best_format = NULL;
     if (formats == NULL)
-        return false;
+        return NULL;
     int best_fps = 0;
     for (int i = 0; i < format_count; i++) {
         SDL_CameraSpec *f = formats[i];
@@ -82,45 +131,120 @@ bool open_camera(SDL_CameraID device) {
         }
     }
 
-    cam_state.camera = SDL_OpenCamera(device, best_format);
-    if (cam_state.camera == NULL) {
-        SDL_free(formats);
-        cam_state.ready = false;
-        return false;
+    SDL_Camera *camera = NULL;
+    if (best_format != NULL) {
+        camera = SDL_OpenCamera(device, best_format);
+        if (camera) *spec = *best_format;
+    }
+    SDL_free(formats);
+    return camera;
+}
+
+/* font size of a grid resx columns wide filling rect, clamps resx and sets
+   resy. rows follow from the camera and the cell shape of the ascii font,
+   so cells are as wide as the glyphs instead of square. touches no state
+*/
+float grid_font_size(AsciiContext *ctx, SDL_FRect rect, float aspect_ratio, int *resx, int *resy) {
+    int limit = SDL_clamp((int)rect.w / MIN_CELL_WIDTH, LIMIT_LOWER, LIMIT_UPPER);
+    *resx = SDL_clamp(*resx, LIMIT_LOWER, limit);
+    return ascii_grid_font_size(ctx, *resx, aspect_ratio, rect.h, resy);
+}
+
+// columns of the grid, the font size follows
+void set_grid_width(int resx) {
+    cam_state.resx = resx;
+    float size = grid_font_size(ascii, g_state.cam_rect, cam_state.aspect_ratio, &cam_state.resx, &cam_state.resy);
+    ascii_update_font_size(ascii, size);
+    update_window_title();
+}
+
+// camera rect left of the UI bar, the window is as high as the camera
+SDL_FRect windowed_rect(float aspect_ratio) {
+    int rect_width = WINDOW_WIDTH - BAR_WIDTH;
+    return (SDL_FRect){0, 0, rect_width, (int)(rect_width * aspect_ratio)};
+}
+
+/* where the camera goes, left of the UI bar with the window height
+   following the camera, or as large as it fits on the screen in fullscreen
+*/
+void layout_camera() {
+    if (g_state.fullscreen) {
+        SDL_GetWindowSize(window, &g_state.window_width, &g_state.window_height);
+        float w = g_state.window_width, h = w * cam_state.aspect_ratio;
+        if (h > g_state.window_height) {
+            h = g_state.window_height;
+            w = h / cam_state.aspect_ratio;
+        }
+        g_state.cam_rect = (SDL_FRect){(g_state.window_width - w) / 2, (g_state.window_height - h) / 2, w, h};
+        return;
     }
+    g_state.window_width = WINDOW_WIDTH;
+    g_state.cam_rect = windowed_rect(cam_state.aspect_ratio);
+    g_state.window_height = g_state.cam_rect.h;
+}
 
-    // update state
+// make an opened camera current
+void use_camera(SDL_Camera *camera, SDL_CameraSpec *spec) {
+    cam_state.camera = camera;
     cam_state.ready = true;
-    cam_state.aspect_ratio = (float)best_format->height / best_format->width;
-    cam_state.resx = DEFAULT_RES;
-    cam_state.resy = cam_state.resx * cam_state.aspect_ratio;
-    cam_state.fps = best_format->framerate_numerator / best_format->framerate_denominator;
-
-    int rect_width = g_state.window_width - BAR_WIDTH;
-    g_state.window_height = rect_width * cam_state.aspect_ratio;
-    g_state.cam_rect = (SDL_FRect){
-        .x = 0,
-        .y = 0,
-        .w = rect_width,
-        .h = g_state.window_height,
-    };
+    cam_state.aspect_ratio = (float)spec->height / spec->width;
+    cam_state.fps = spec->framerate_numerator / spec->framerate_denominator;
+    layout_camera();
 
     // update these on new camera open
-    ascii_update_font_size((float)g_state.cam_rect.h / cam_state.resy);
-    update_window_title();
+    set_grid_width(DEFAULT_RES);
+    metrics_set_camera(true);
+}
 
-    SDL_free(formats);
+bool open_camera(SDL_CameraID device) {
+    if (cam_state.camera != NULL) SDL_CloseCamera(cam_state.camera);
+    cam_state.camera = NULL;
+
+    SDL_CameraSpec spec;
+    SDL_Camera *camera = open_best_format(device, &spec);
+    if (camera == NULL) {
+        cam_state.ready = false;
+        metrics_set_camera(false);
+        return false;
+    }
+    use_camera(camera, &spec);
     return true;
 }
 
-void load_cameras() {
+// size window and render texture to the current camera
+void resize_window() {
+    // keep window in same position, fullscreen keeps the screen size
+    if (!g_state.fullscreen) {
+        int x, y;
+        SDL_GetWindowPosition(window, &x, &y);
+        SDL_SetWindowSize(window, g_state.window_width, g_state.window_height);
+        SDL_SetWindowPosition(window, x, y);
+    }
+
+    if (g_state.fbo != NULL) SDL_DestroyTexture(g_state.fbo);
+    g_state.fbo = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_TARGET,
+                                    g_state.cam_rect.w, g_state.cam_rect.h);
+    g_state.target.valid = false;
+}
+
+// entering or leaving fullscreen, or the screen size changed while in it
+void relayout(bool fullscreen) {
+    g_state.fullscreen = fullscreen;
+    if (!cam_state.ready) return;
+    layout_camera();
+    resize_window();
+    set_grid_width(cam_state.resx);
+}
+
+SDL_CameraID *load_cameras(int *count) {
     // load devices
-    cam_state.devices = SDL_GetCameras(&cam_state.dev_count);
-    if (cam_state.devices == NULL) {
+    SDL_CameraID *devices = SDL_GetCameras(count);
+    if (devices == NULL) {
         ERROR("Couldn't enumerate devices\n%s", SDL_GetError());
-    } else if (cam_state.dev_count == 0) {
+    } else if (*count == 0) {
         ERROR("No camera device found\n%s", SDL_GetError());
     }
+    return devices;
 }
 
 // set camera to current index + given offset
@@ -143,15 +267,7 @@ void set_camera(int offset) {
     SDL_CameraID device = cam_state.devices[index];
 
     if (open_camera(device)) {
-        // keep window in same position
-        int x, y;
-        SDL_GetWindowPosition(window, &x, &y);
-        SDL_SetWindowSize(window, g_state.window_width, g_state.window_height);
-        SDL_SetWindowPosition(window, x, y);
-
-        if (g_state.fbo != NULL) SDL_DestroyTexture(g_state.fbo);
-        g_state.fbo = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_TARGET,
-                                        g_state.cam_rect.w, g_state.cam_rect.h);
+        resize_window();
     } else {
         update_window_title(); // update to default
         ERROR("Couldn't open camera %s\n%s", SDL_GetCameraName(device), SDL_GetError());
@@ -160,9 +276,192 @@ void set_camera(int offset) {
     cam_state.cam_index = index;
 }
 
+//---View---
+
+// the view keeps the camera aspect ratio and stays inside the frame
+void clamp_view() {
+    AsciiView *v = &g_state.view;
+    v->w = v->h = SDL_clamp(v->w, 1.0f / ZOOM_MAX, 1.0f);
+    v->x = SDL_clamp(v->x, 0.0f, 1.0f - v->w);
+    v->y = SDL_clamp(v->y, 0.0f, 1.0f - v->h);
+}
+
+// window position in 0..1 of the camera rect, as a point of the unmirrored view
+void view_point(float wx, float wy, float *px, float *py) {
+    *px = (wx - g_state.cam_rect.x) / g_state.cam_rect.w;
+    *py = (wy - g_state.cam_rect.y) / g_state.cam_rect.h;
+    if (g_state.view.mirror) *px = 1.0f - *px;
+}
+
+// zoom keeping the point px, py of the view in place
+void zoom_view(float factor, float px, float py) {
+    AsciiView *v = &g_state.view;
+    float x = v->x + px * v->w, y = v->y + py * v->h;
+    v->w = v->h = v->w / factor;
+    clamp_view();
+    v->x = x - px * v->w;
+    v->y = y - py * v->h;
+    clamp_view();
+}
+
+// move by dx, dy of the view as seen on screen
+void pan_view(float dx, float dy) {
+    AsciiView *v = &g_state.view;
+    v->x += (v->mirror ? -dx : dx) * v->w;
+    v->y += dy * v->h;
+    clamp_view();
+}
+
+//---Idle---
+
+// anything that needs frames while the window can't be seen
+bool idle_outputs() { return idle.outputs || record_active(); }
+
+void idle_hide() {
+    if (idle.hidden) return;
+    idle.hidden = true;
+    idle.hidden_since = SDL_GetTicksNS();
+}
+
+// the camera reopens with the same grid size
+void idle_show() {
+    if (!idle.hidden) return;
+    idle.hidden = false;
+    if (!idle.released) return;
+    idle.released = false;
+    if (cam_state.ready) return; // reconnected while hidden
+    int resx = cam_state.resx;
+    if (cam_state.dev_count > 0 && open_camera(cam_state.devices[cam_state.cam_index])) {
+        resize_window(); // fullscreen may have changed while it was closed
+        set_grid_width(resx);
+    }
+}
+
+// closes the camera once hidden long enough with nothing else using it
+void idle_release_camera() {
+    if (idle.released || idle.release_after <= 0 || !cam_state.ready || idle_outputs()) return;
+    if (SDL_GetTicksNS() - idle.hidden_since < (Uint64)idle.release_after * SDL_NS_PER_SECOND) return;
+    SDL_Log("Hidden for %ds, closing the camera", idle.release_after);
+    SDL_CloseCamera(cam_state.camera);
+    cam_state.camera = NULL;
+    cam_state.ready = false;
+    metrics_set_camera(false);
+    idle.released = true;
+}
+
+#define MS_SINCE(t) ((SDL_GetTicksNS() - (t)) / 1e6)
+
+/* ascii font size of ctx for the current camera. a guess of the default
+   grid in the window until one is open, and before the font is loaded
+*/
+float cell_size(AsciiContext *ctx) {
+    float cell_w = (float)(WINDOW_WIDTH - BAR_WIDTH) / DEFAULT_RES;
+    if (ctx == NULL) return cell_w;
+    if (g_state.cam_rect.h > 0) return ascii_cell_font_size(ctx, g_state.cam_rect.h / cam_state.resy);
+    return ascii_cell_font_size(ctx, cell_w / ascii_cell_aspect(ctx));
+}
+
+// take over a reloaded context, main thread only
+void swap_ascii(AsciiContext *ctx) {
+    if (!ascii_set_renderer(ctx, renderer)) {
+        ascii_destroy(ctx);
+        return;
+    }
+    ascii_update_font_size(ctx, cell_size(ctx));
+    // the recording's own context still has the old tables
+    if (record_active()) {
+        SDL_Log("Tables reloaded, stopping recording");
+        record_stop();
+    }
+    ascii_destroy(ascii);
+    ascii = ctx;
+    g_state.ascii_table_count = ascii_get_table_count(ascii);
+    if (g_state.ascii_table_index >= g_state.ascii_table_count) g_state.ascii_table_index = 0;
+}
+
+/* fonts, tables and every table's glyphs are prepared off the main thread.
+   glyphs are baked at the size use_camera is going to set, so they are
+   only baked once
+*/
+int SDLCALL ascii_thread(void *data) {
+    (void)data;
+    trace_thread_name("ascii startup");
+    Uint64 t = trace_begin();
+    AsciiContext *ctx = ascii_create(NULL, cell_size(NULL), startup.table_file);
+    trace_end("fonts and tables", t);
+    if (ctx) {
+        SDL_WaitSemaphore(startup.camera_signal);
+        if (startup.camera) {
+            float aspect_ratio = (float)startup.spec.height / startup.spec.width;
+            int resx = DEFAULT_RES, resy;
+            ascii_update_font_size(ctx, grid_font_size(ctx, windowed_rect(aspect_ratio), aspect_ratio, &resx, &resy));
+        }
+        t = trace_begin();
+        for (int i = 0; i < ascii_get_table_count(ctx); i++)
+            ascii_bake_glyphs(ctx, i);
+        trace_end("bake glyphs", t);
+    }
+    startup.ascii = ctx;
+    SDL_Log("Fonts ready in %.1f ms", MS_SINCE(startup.start));
+    SDL_SetAtomicInt(&startup.ascii_done, 1);
+    return 0;
+}
+
+// camera subsystem init and device open can each block for a long time
+int SDLCALL camera_thread(void *data) {
+    (void)data;
+    trace_thread_name("camera startup");
+    Uint64 t = trace_begin();
+    if (!SDL_InitSubSystem(SDL_INIT_CAMERA)) {
+        ERROR("Failed to initialize camera\n%s", SDL_GetError());
+    } else {
+        startup.devices = load_cameras(&startup.dev_count);
+        if (startup.dev_count > 0) {
+            SDL_CameraID device = startup.devices[0];
+            startup.camera = open_best_format(device, &startup.spec);
+            if (startup.camera == NULL)
+                ERROR("Couldn't open camera %s\n%s", SDL_GetCameraName(device), SDL_GetError());
+            else
+                SDL_Log("Camera open in %.1f ms", MS_SINCE(startup.start));
+        }
+    }
+    trace_end("camera open", t);
+    SDL_SetAtomicInt(&startup.camera_done, 1);
+    SDL_SignalSemaphore(startup.camera_signal);
+    return 0;
+}
+
+bool starting() { return startup.ascii_thread != NULL || startup.camera_thread != NULL; }
+
+// pick up finished startup work, main thread only
+void poll_startup() {
+    if (startup.ascii_thread && SDL_GetAtomicInt(&startup.ascii_done)) {
+        SDL_WaitThread(startup.ascii_thread, NULL);
+        startup.ascii_thread = NULL;
+        ascii = startup.ascii;
+        if (ascii == NULL || !ascii_set_renderer(ascii, renderer)) EXIT(69);
+        g_state.ascii_table_index = 0;
+        g_state.ascii_table_count = ascii_get_table_count(ascii);
+    }
+    // camera state sets the ascii font size so fonts come first
+    if (ascii && startup.camera_thread && SDL_GetAtomicInt(&startup.camera_done)) {
+        SDL_WaitThread(startup.camera_thread, NULL);
+        startup.camera_thread = NULL;
+        cam_state.devices = startup.devices;
+        cam_state.dev_count = startup.dev_count;
+        if (startup.camera) {
+            use_camera(startup.camera, &startup.spec);
+            resize_window();
+        }
+    }
+}
+
 void init(char *table_file) {
-    // SDL
-    if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_CAMERA)) {
+    startup.start = SDL_GetTicksNS();
+    startup.table_file = table_file;
+
+    // SDL, camera is initialized on its own thread
+    if (!SDL_Init(SDL_INIT_VIDEO)) {
         ERROR("Failed to initialize SDL\n%s", SDL_GetError());
         EXIT(69);
     }
@@ -174,38 +473,59 @@ void init(char *table_file) {
     cam_state.ready = false;
     cam_state.cam_index = 0;
 
-    load_cameras();
-    SDL_CameraID device = cam_state.devices[cam_state.cam_index];
-    if (!open_camera(device)) {
-        ERROR("Couldn't open camera %s\n%s", SDL_GetCameraName(device), SDL_GetError());
+    startup.camera_signal = SDL_CreateSemaphore(0);
+    if (startup.camera_signal == NULL) {
+        ERROR("Failed to create startup semaphore\n%s", SDL_GetError());
+        EXIT(69);
+    }
+    startup.ascii_thread = SDL_CreateThread(ascii_thread, "ascii startup", NULL);
+    startup.camera_thread = SDL_CreateThread(camera_thread, "camera startup", NULL);
+    if (startup.ascii_thread == NULL || startup.camera_thread == NULL) {
+        ERROR("Failed to create startup threads\n%s", SDL_GetError());
+        EXIT(69);
     }
 
-    // renderer
+    // renderer, shown before anything else is ready
     if (!SDL_CreateWindowAndRenderer("J-Ascii2", g_state.window_width,
                                      g_state.window_height, 0, &window, &renderer)) {
         ERROR("Failed to create window and renderer\n%s", SDL_GetError());
         EXIT(69);
     }
-    // create render texture on successfull init
-    if (cam_state.ready)
-        g_state.fbo = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_TARGET,
-                                        g_state.cam_rect.w, g_state.cam_rect.h);
-
-
-    float font_size = (float)g_state.cam_rect.h / cam_state.resy;
-    ascii_init(renderer, font_size, table_file);
-    g_state.ascii_table_index = 0;
-    g_state.ascii_table_count = ascii_get_table_count();
+    SDL_SetRenderDrawColor(renderer, ASCII_BACKGROUND, ASCII_BACKGROUND, ASCII_BACKGROUND, 0xFF);
+    SDL_RenderClear(renderer);
+    SDL_RenderPresent(renderer);
+    SDL_Log("Window shown in %.1f ms", MS_SINCE(startup.start));
 }
 
 void deinit() {
-    ascii_deinit();
+    // startup threads only touch their own results, wait for them
+    SDL_WaitThread(startup.ascii_thread, NULL);
+    SDL_WaitThread(startup.camera_thread, NULL);
+    SDL_DestroySemaphore(startup.camera_signal);
+    if (ascii == NULL) ascii = startup.ascii;
+    if (cam_state.devices == NULL) {
+        cam_state.devices = startup.devices;
+        cam_state.camera = startup.camera;
+    }
+
+    table_watch_stop();
+    record_stop();
+    shm_out_close();
+    http_out_stop();
+    telnet_out_stop();
+    metrics_stop();
+    ascii_grid_free(&g_state.grid);
+    ascii_grid_free(&g_state.target.grid);
+    SDL_DestroySurface(g_state.frame);
+    ascii_destroy(ascii);
+    trace_stop();
 
     SDL_free(cam_state.devices);
     SDL_CloseCamera(cam_state.camera);
     SDL_DestroyTexture(g_state.fbo);
     SDL_DestroyWindow(window);
     SDL_DestroyRenderer(renderer);
+    log_ring_stop();
     SDL_Quit();
 }
 
@@ -213,6 +533,8 @@ void handle_events(bool *quit) {
     SDL_Event e;
     while(SDL_PollEvent(&e)) {
         if (e.type == SDL_EVENT_QUIT) *quit = true;
+        // only quitting works until startup is done
+        if (e.type == SDL_EVENT_KEY_DOWN && e.key.key != SDLK_ESCAPE && starting()) continue;
         if (e.type == SDL_EVENT_KEY_DOWN) {
             switch (e.key.key) {
 
@@ -220,20 +542,67 @@ void handle_events(bool *quit) {
                 break;
 
                 // Frame scale
-                case SDLK_EQUALS: {
-                    cam_state.resx /= SCALE_STEP;
-                    cam_state.resx = cam_state.resx < LIMIT_LOWER ? LIMIT_LOWER : cam_state.resx;
-                    cam_state.resy = cam_state.resx * cam_state.aspect_ratio;
-                    ascii_update_font_size(g_state.cam_rect.h / cam_state.resy);
-                    update_window_title();
+                case SDLK_EQUALS:
+                    set_grid_width(cam_state.resx / SCALE_STEP);
+                break;
+                case SDLK_MINUS:
+                    set_grid_width(cam_state.resx * SCALE_STEP);
+                break;
+
+                // Recording
+                case SDLK_R: {
+                    if (record_active()) {
+                        record_stop();
+                    } else if (cam_state.ready) {
+                        char path[64];
+                        SDL_Time now = 0;
+                        SDL_GetCurrentTime(&now);
+                        sprintf(path, "j-ascii-%lld.y4m", (long long)(now / SDL_NS_PER_SECOND));
+                        record_start(path, startup.table_file, g_state.fbo->w, g_state.fbo->h, cam_state.fps);
+                    }
                 }
                 break;
-                case SDLK_MINUS: {
-                    cam_state.resx *= SCALE_STEP;
-                    cam_state.resx = cam_state.resx > LIMIT_UPPER ? LIMIT_UPPER : cam_state.resx;
-                    cam_state.resy = cam_state.resx * cam_state.aspect_ratio;
-                    ascii_update_font_size(g_state.cam_rect.h / cam_state.resy);
-                    update_window_title();
+
+                // Trace so far
+                case SDLK_T:
+                    trace_write();
+                break;
+
+                case SDLK_F11:
+                    SDL_SetWindowFullscreen(window, !g_state.fullscreen);
+                break;
+
+                // Render mode
+                case SDLK_M:
+                    g_state.mode = (g_state.mode + 1) % ASCII_MODE_COUNT;
+                break;
+
+                // View
+                case SDLK_I:
+                    zoom_view(ZOOM_STEP, 0.5f, 0.5f);
+                break;
+                case SDLK_O:
+                    zoom_view(1.0f / ZOOM_STEP, 0.5f, 0.5f);
+                break;
+                case SDLK_W:
+                    pan_view(0, -PAN_STEP);
+                break;
+                case SDLK_A:
+                    pan_view(-PAN_STEP, 0);
+                break;
+                case SDLK_S:
+                    pan_view(0, PAN_STEP);
+                break;
+                case SDLK_D:
+                    pan_view(PAN_STEP, 0);
+                break;
+                case SDLK_F:
+                    g_state.view.mirror = !g_state.view.mirror;
+                break;
+                case SDLK_0: {
+                    bool mirror = g_state.view.mirror;
+                    g_state.view = ASCII_VIEW_FULL;
+                    g_state.view.mirror = mirror;
                 }
                 break;
 
@@ -260,6 +629,48 @@ void handle_events(bool *quit) {
             }
         }
 
+        // wheel zooms at the cursor, dragging pans
+        if (e.type == SDL_EVENT_MOUSE_WHEEL && e.wheel.y != 0 && cam_state.ready) {
+            float px, py;
+            view_point(e.wheel.mouse_x, e.wheel.mouse_y, &px, &py);
+            if (px >= 0 && px <= 1 && py >= 0 && py <= 1)
+                zoom_view(SDL_powf(ZOOM_STEP, e.wheel.y), px, py);
+        }
+        if (e.type == SDL_EVENT_MOUSE_MOTION && (e.motion.state & SDL_BUTTON_LMASK) && cam_state.ready) {
+            pan_view(-e.motion.xrel / g_state.cam_rect.w, -e.motion.yrel / g_state.cam_rect.h);
+        }
+
+        //--Window events---
+        switch (e.type) {
+            case SDL_EVENT_WINDOW_ENTER_FULLSCREEN:
+                relayout(true);
+            break;
+            case SDL_EVENT_WINDOW_LEAVE_FULLSCREEN:
+                relayout(false);
+            break;
+            case SDL_EVENT_WINDOW_RESIZED:
+                if (g_state.fullscreen) relayout(true);
+            break;
+            // target textures lost what was drawn into them
+            case SDL_EVENT_RENDER_TARGETS_RESET:
+            case SDL_EVENT_RENDER_DEVICE_RESET:
+                g_state.target.valid = false;
+            break;
+            case SDL_EVENT_WINDOW_MINIMIZED:
+            case SDL_EVENT_WINDOW_HIDDEN:
+            case SDL_EVENT_WINDOW_OCCLUDED:
+                idle_hide();
+            break;
+            // losing focus alone doesn't hide the window, gaining it means it is back
+            case SDL_EVENT_WINDOW_RESTORED:
+            case SDL_EVENT_WINDOW_MAXIMIZED:
+            case SDL_EVENT_WINDOW_SHOWN:
+            case SDL_EVENT_WINDOW_EXPOSED:
+            case SDL_EVENT_WINDOW_FOCUS_GAINED:
+                idle_show();
+            break;
+        }
+
         //--Camera events---
         if (e.type == SDL_EVENT_CAMERA_DEVICE_ADDED) {
             SDL_CameraID device = e.cdevice.which;
@@ -269,6 +680,8 @@ void handle_events(bool *quit) {
             SDL_CameraID device = e.cdevice.which;
             SDL_Log("%s disconnected", SDL_GetCameraName(device));
             cam_state.ready = false;
+            metrics_add(METRIC_CAMERA_DISCONNECTS, 1);
+            metrics_set_camera(false);
             update_window_title(); // lost current cam so should set to default
         }
     }
@@ -277,25 +690,74 @@ void handle_events(bool *quit) {
 
 int main(int argc, char *argv[]) {
 
-    // args
-    if (!(argc == 1 || argc == 3)) {
-        if (argc == 2) {
-            char *flag = argv[1];
-            if (strcmp(flag, "-h") == 0 || strcmp(flag, "--help") == 0) {
-                SDL_Log("Usage: j-ascii | j-ascii -f <.tbl file>");
-                SDL_Log("if no file is provided ascii.tbl is searched for in the working directory.");
-                SDL_Log("default ascii table is always included.");
-                return 0;
-            }
-        }
-        ERROR("Invalid arguments");
-        return 1;
+    // offline mode
+    if (argc >= 2 && strcmp(argv[1], "transcode") == 0) {
+        return transcode_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        // before SDL allocates anything
+        alloc_stats_install();
+        return bench_main(argc - 2, argv + 2);
     }
+    if (argc >= 2 && strcmp(argv[1], "golden") == 0) {
+        return golden_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "quality") == 0) {
+        return quality_main(argc - 2, argv + 2);
+    }
+
+    // args
     char *table_file = NULL;
-    if (argc == 3) {
-        char *flag = argv[1];
-        if (strcmp(flag, "-f") == 0) {
-            table_file = argv[2];
+    char *shm_name = NULL;
+    char *trace_path = NULL;
+    char *metrics_address = NULL;
+    int http_port = 0;
+    char *telnet_address = NULL;
+    int telnet_w = 80, telnet_h = 24;
+    for (int i = 1; i < argc; i++) {
+        char *flag = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(flag, "-h") == 0 || strcmp(flag, "--help") == 0) {
+            SDL_Log("Usage: j-ascii [-f <.tbl file>] [--shm <name>] [--http <port>]");
+            SDL_Log("               [--telnet [addr:]<port>] [--telnet-size <WxH>] [--trace <file>]");
+            SDL_Log("               [--metrics [addr:]<port>] [--idle-release <seconds>]");
+            SDL_Log("               [--still <threshold>]");
+            SDL_Log("if no file is provided ascii.tbl is searched for in the working directory.");
+            SDL_Log("the table file is reloaded whenever it changes.");
+            SDL_Log("default ascii table is always included.");
+            SDL_Log("--shm publishes every frame to a shared memory ring, see reader/.");
+            SDL_Log("--http serves a live browser view on 127.0.0.1:<port>.");
+            SDL_Log("--telnet streams ANSI ascii to terminals, default size 80x24, on 127.0.0.1 unless addr is given.");
+            SDL_Log("--metrics serves Prometheus metrics on /metrics, on 127.0.0.1 unless addr is given.");
+            SDL_Log("--idle-release closes the camera after the window was hidden that long.");
+            SDL_Log("--still only recomputes blocks of cells whose pixels moved more than threshold (0-255).");
+            SDL_Log("--trace writes a Chrome trace of every frame on exit and when T is pressed.");
+            SDL_Log("j-ascii transcode -h for offline video transcoding.");
+            SDL_Log("j-ascii bench -h for benchmarks.");
+            SDL_Log("j-ascii golden -h for checking render output against golden hashes.");
+            SDL_Log("j-ascii quality -h for scoring render quality against frame time.");
+            return 0;
+        } else if (strcmp(flag, "-f") == 0 && has_value) {
+            table_file = argv[++i];
+        } else if (strcmp(flag, "--trace") == 0 && has_value) {
+            trace_path = argv[++i];
+        } else if (strcmp(flag, "--shm") == 0 && has_value) {
+            shm_name = argv[++i];
+        } else if (strcmp(flag, "--http") == 0 && has_value) {
+            http_port = SDL_atoi(argv[++i]);
+        } else if (strcmp(flag, "--metrics") == 0 && has_value) {
+            metrics_address = argv[++i];
+        } else if (strcmp(flag, "--still") == 0 && has_value) {
+            g_state.grid.tile_threshold = SDL_atoi(argv[++i]);
+        } else if (strcmp(flag, "--idle-release") == 0 && has_value) {
+            idle.release_after = SDL_atoi(argv[++i]);
+        } else if (strcmp(flag, "--telnet") == 0 && has_value) {
+            telnet_address = argv[++i];
+        } else if (strcmp(flag, "--telnet-size") == 0 && has_value) {
+            if (sscanf(argv[++i], "%dx%d", &telnet_w, &telnet_h) != 2) {
+                ERROR("Invalid size %s", argv[i]);
+                return 1;
+            }
         } else {
             ERROR("Invalid argument %s", flag);
             return 1;
@@ -307,74 +769,194 @@ int main(int argc, char *argv[]) {
     g_state.window_height = WINDOW_HEIGHT;
     g_state.time_prev = 0;
     g_state.time_delta = FRAME_TIME;
+    g_state.view = ASCII_VIEW_FULL;
+    // logging from the frame loop must not wait on the terminal
+    log_ring_start();
+    if (trace_path && !trace_start(trace_path)) return 1;
+    trace_thread_name("main");
     init(table_file);
+    table_watch_start(table_file);
+    // sized for the default grid, the ring grows when a larger grid is published
+    if ((shm_name && !shm_out_open(shm_name, DEFAULT_RES * DEFAULT_RES)) ||
+        (http_port && !http_out_start(http_port)) ||
+        (telnet_address && !telnet_out_start(telnet_address, telnet_w, telnet_h)) ||
+        (metrics_address && !metrics_start(metrics_address))) {
+        deinit();
+        return 1;
+    }
+    idle.outputs = shm_name || http_port || telnet_address;
 
     while(!quit) {
+        Uint64 frame_begin = metrics_begin();
         // input
+        Uint64 t = trace_begin();
         handle_events(&quit);
+        trace_end("handle_events", t);
+        if (starting()) poll_startup();
+        // tables edited on disk are swapped in between frames, loaded at the size the view uses
+        else if (ascii) {
+            AsciiContext *reloaded = table_watch_poll(cell_size(ascii));
+            if (reloaded) swap_ascii(reloaded);
+        }
+
+        // hidden with nothing else to feed, sleep until an event shows the window
+        if (idle.hidden && !starting() && !idle_outputs()) {
+            idle_release_camera();
+            SDL_WaitEventTimeout(NULL, IDLE_WAIT_MS);
+            continue;
+        }
 
         // camera frame
-        SDL_Surface *camera_frame = SDL_AcquireCameraFrame(cam_state.camera, NULL);
+        t = trace_begin();
+        Uint64 timestamp = 0;
+        SDL_Surface *camera_frame = SDL_AcquireCameraFrame(cam_state.camera, &timestamp);
+        trace_end("camera acquire", t);
+        Uint64 m;
 
         // since camera provides at fixed fps we dont update texture until new frame
         if (camera_frame) {
+            metrics_camera_frame(timestamp, cam_state.fps);
             // scale frame
-            SDL_Surface *frame = SDL_CreateSurface(cam_state.resx, cam_state.resy, SDL_PIXELFORMAT_RGB24);
-            SDL_BlitSurfaceScaled(camera_frame, NULL, frame, NULL, SDL_SCALEMODE_NEAREST);
+            // modes can sample several pixels per cell
+            int sx, sy;
+            ascii_mode_scale(g_state.mode, &sx, &sy);
+            t = trace_begin();
+            m = metrics_begin();
+            SDL_Surface *frame = g_state.frame;
+            if (frame == NULL || frame->w != cam_state.resx * sx || frame->h != cam_state.resy * sy) {
+                SDL_DestroySurface(frame);
+                frame = g_state.frame = SDL_CreateSurface(cam_state.resx * sx, cam_state.resy * sy, SDL_PIXELFORMAT_RGB24);
+            }
+            ascii_sample(camera_frame, &g_state.view, frame);
+            trace_end("scale", t);
+            metrics_end(METRIC_STAGE_SCALE, m);
+            t = trace_begin();
+            telnet_out_publish(ascii, camera_frame, &g_state.view, g_state.mode, g_state.ascii_table_index);
+            trace_end("telnet publish", t);
             SDL_ReleaseCameraFrame(cam_state.camera, camera_frame);
 
-            SDL_SetRenderTarget(renderer, g_state.fbo);
-            ascii_render(renderer, &g_state.cam_rect, frame, g_state.ascii_table_index);
-            SDL_SetRenderTarget(renderer, NULL);
+            t = trace_begin();
+            m = metrics_begin();
+            ascii_grid_resize(&g_state.grid, cam_state.resx, cam_state.resy);
+            ascii_compute_mode(ascii, g_state.mode, &g_state.grid, frame, g_state.ascii_table_index);
+            trace_end("ascii compute", t);
+            metrics_end(METRIC_STAGE_COMPUTE, m);
+            t = trace_begin();
+            m = metrics_begin();
+            shm_out_publish(ascii, &g_state.grid);
+            http_out_publish(ascii, &g_state.grid);
+            metrics_publish_grid(&g_state.grid);
+            record_capture(&g_state.grid);
+            trace_end("publish", t);
+            metrics_end(METRIC_STAGE_PUBLISH, m);
+
+            // nothing shows the texture while hidden
+            if (!idle.hidden) {
+                t = trace_begin();
+                m = metrics_begin();
+                SDL_SetRenderTarget(renderer, g_state.fbo);
+                SDL_FRect fbo_rect = {0, 0, g_state.cam_rect.w, g_state.cam_rect.h};
+                ascii_draw_changed(ascii, &fbo_rect, &g_state.grid, &g_state.target);
+                SDL_SetRenderTarget(renderer, NULL);
+                trace_end("ascii draw", t);
+                metrics_end(METRIC_STAGE_DRAW, m);
+                metrics_add(METRIC_FRAMES_RENDERED, 1);
+            }
+
+            if (!startup.first_frame) {
+                startup.first_frame = true;
+                SDL_Log("Time to first ascii frame %.1f ms", MS_SINCE(startup.start));
+            }
+        }
 
-            SDL_DestroySurface(frame);
+        // outputs have their frame, nothing to present
+        if (idle.hidden) {
+            SDL_WaitEventTimeout(NULL, FRAME_TIME);
+            continue;
         }
 
         //---Render---
         SDL_RenderClear(renderer);
 
-        // not connected
-        if (!cam_state.ready) {
+        // nothing to draw text with yet
+        if (ascii == NULL) {
+            SDL_RenderPresent(renderer);
+            SDL_Delay(FRAME_TIME);
+            continue;
+        }
+
+        if (starting()) {
+            update_font_size(ascii, 48.0f);
+            char *text = "Starting...";
+            int w, h;
+            measure_string(ascii, text, &w, &h);
+            render_string(ascii, text, (g_state.window_width - w) / 2, (g_state.window_height - h) / 2,
+                          (SDL_Color){255, 255, 255, 255});
+        } else if (!cam_state.ready) {
+            // not connected
             // try reconnect
-            open_camera(cam_state.devices[cam_state.cam_index]);
+            t = trace_begin();
+            if (cam_state.dev_count > 0 && open_camera(cam_state.devices[cam_state.cam_index]))
+                metrics_add(METRIC_CAMERA_RECONNECTS, 1);
+            trace_end("open_camera", t);
 
-            update_font_size(48.0f);
+            update_font_size(ascii, 48.0f);
             char *text = "Disconnected...";
             int w, h;
-            measure_string(text, &w, &h);
-            render_string(text, (g_state.window_width - w) / 2, (g_state.window_height - h) / 2,
+            measure_string(ascii, text, &w, &h);
+            render_string(ascii, text, (g_state.window_width - w) / 2, (g_state.window_height - h) / 2,
                           (SDL_Color){255, 0, 0, 255});
         } else {
             SDL_RenderTexture(renderer, g_state.fbo, NULL, &g_state.cam_rect);
         }
 
         //---UI---
-        update_font_size(24.0f);
+        t = trace_begin();
+        update_font_size(ascii, 24.0f);
         SDL_Color color = {40, 0, 255, 255};
         char text[128];
         int w, h;
 
         // Cameras
         sprintf(text, "Camera %d/%d", cam_state.cam_index + 1, cam_state.dev_count);
-        measure_string(text, &w, &h);
-        render_string(text, g_state.window_width - w - 10, 10, color);
+        measure_string(ascii, text, &w, &h);
+        render_string(ascii, text, g_state.window_width - w - 10, 10, color);
         // Ascii table
         sprintf(text, "Table: %d/%d", g_state.ascii_table_index + 1, g_state.ascii_table_count);
-        measure_string(text, &w, &h);
-        render_string(text, g_state.window_width - w - 10, 20 + h, color);
+        measure_string(ascii, text, &w, &h);
+        render_string(ascii, text, g_state.window_width - w - 10, 20 + h, color);
+        // Mode
+        sprintf(text, "Mode: %s", ascii_mode_name(g_state.mode));
+        measure_string(ascii, text, &w, &h);
+        render_string(ascii, text, g_state.window_width - w - 10, 30 + 2 * h, color);
+        // Recording
+        if (record_active()) {
+            sprintf(text, "REC dropped %d", record_dropped());
+            measure_string(ascii, text, &w, &h);
+            render_string(ascii, text, g_state.window_width - w - 10, 40 + 3 * h, (SDL_Color){255, 0, 0, 255});
+        }
+
+        trace_end("ui", t);
 
         // SWAP BUFFERS
+        t = trace_begin();
+        m = metrics_begin();
         SDL_RenderPresent(renderer);
+        trace_end("present", t);
+        metrics_end(METRIC_STAGE_PRESENT, m);
 
         // FPS cap
         Uint64 time = SDL_GetTicks();
         g_state.time_delta = time - g_state.time_prev;
         Uint32 delay_time = (Uint32)FRAME_TIME - g_state.time_delta;
         if (g_state.time_delta < FRAME_TIME) {
+            t = trace_begin();
             SDL_Delay(delay_time);
+            trace_end("frame cap", t);
         }
         g_state.time_delta += delay_time;
         g_state.time_prev = time + delay_time;
+        metrics_end(METRIC_STAGE_FRAME, frame_begin);
 
     }
 
@@ -0,0 +1,343 @@
+#include <SDL3/SDL.h>
+
+#include "metrics.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define REQUEST_MAX 4096
+#define RESPONSE_MAX (32 * 1024)
+// a scraper gets this long to send its request
+#define REQUEST_TIMEOUT_MS 1000
+// a camera timestamp gap longer than this is a restart, not drops
+#define MAX_DROP_GAP_NS SDL_NS_PER_SECOND
+#define DIRTY_SCALE 1000000
+
+// upper bounds in seconds, +Inf is implied
+static const double buckets[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25};
+#define BUCKET_COUNT ((int)SDL_arraysize(buckets) + 1)
+
+static const struct {
+    const char *name;
+    const char *help;
+} counter_info[METRIC_COUNTER_COUNT] = {
+    [METRIC_FRAMES_CAPTURED] = {"jascii_frames_captured_total", "Camera frames acquired."},
+    [METRIC_FRAMES_RENDERED] = {"jascii_frames_rendered_total", "Ascii frames drawn."},
+    [METRIC_FRAMES_DROPPED] = {"jascii_frames_dropped_total", "Camera frames missed, from gaps in frame timestamps."},
+    [METRIC_CAMERA_DISCONNECTS] = {"jascii_camera_disconnects_total", "Camera devices lost."},
+    [METRIC_CAMERA_RECONNECTS] = {"jascii_camera_reconnects_total", "Cameras reopened after being lost."},
+};
+
+static const char *stage_names[METRIC_STAGE_COUNT] = {
+    [METRIC_STAGE_SCALE] = "scale",
+    [METRIC_STAGE_COMPUTE] = "compute",
+    [METRIC_STAGE_PUBLISH] = "publish",
+    [METRIC_STAGE_DRAW] = "draw",
+    [METRIC_STAGE_PRESENT] = "present",
+    [METRIC_STAGE_FRAME] = "frame",
+};
+
+// counts per bucket, made cumulative when served
+typedef struct {
+    atomic_ullong buckets[BUCKET_COUNT];
+    atomic_ullong count;
+    atomic_ullong sum_ns;
+} Histogram;
+
+// 64 bit atomics so nothing wraps in a kiosk's lifetime, SDL's are 32 bit
+static struct {
+    bool running;
+    int listen_fd;
+    SDL_Thread *thread;
+    SDL_AtomicInt quit;
+
+    atomic_ullong counters[METRIC_COUNTER_COUNT];
+    atomic_ullong dirty_cells;
+    atomic_ullong cells;
+    Histogram stages[METRIC_STAGE_COUNT];
+    SDL_AtomicInt camera_connected;
+    SDL_AtomicInt grid_w;
+    SDL_AtomicInt grid_h;
+    SDL_AtomicInt table_index;
+    SDL_AtomicInt dirty_ratio; // of the last grid, times DIRTY_SCALE
+
+    // publishing thread only
+    AsciiGrid prev;
+    Uint64 last_timestamp;
+} metrics_state = {0};
+
+//---Updates---
+
+void metrics_add(MetricCounter counter, int n) {
+    if (!metrics_state.running) return;
+    atomic_fetch_add_explicit(&metrics_state.counters[counter], n, memory_order_relaxed);
+}
+
+void metrics_set_camera(bool connected) {
+    if (!metrics_state.running) return;
+    SDL_SetAtomicInt(&metrics_state.camera_connected, connected);
+    // the next frame is from a new stream
+    metrics_state.last_timestamp = 0;
+}
+
+void metrics_camera_frame(Uint64 timestamp_ns, int fps) {
+    if (!metrics_state.running) return;
+    metrics_add(METRIC_FRAMES_CAPTURED, 1);
+    Uint64 last = metrics_state.last_timestamp;
+    metrics_state.last_timestamp = timestamp_ns;
+    if (last == 0 || timestamp_ns <= last || fps <= 0 || timestamp_ns - last > MAX_DROP_GAP_NS) return;
+    // a gap of more than one and a half frame intervals lost a frame per extra interval
+    Uint64 interval = SDL_NS_PER_SECOND / fps;
+    Uint64 missed = (timestamp_ns - last + interval / 2) / interval;
+    if (missed > 1) metrics_add(METRIC_FRAMES_DROPPED, (int)(missed - 1));
+}
+
+void metrics_publish_grid(AsciiGrid *grid) {
+    if (!metrics_state.running) return;
+    SDL_SetAtomicInt(&metrics_state.grid_w, grid->w);
+    SDL_SetAtomicInt(&metrics_state.grid_h, grid->h);
+    SDL_SetAtomicInt(&metrics_state.table_index, grid->table_index);
+
+    int count = grid->w * grid->h;
+    int dirty = count;
+    AsciiGrid *prev = &metrics_state.prev;
+    if (prev->w == grid->w && prev->h == grid->h) {
+        dirty = 0;
+        for (int i = 0; i < count; i++)
+            dirty += SDL_memcmp(&prev->cells[i], &grid->cells[i], sizeof(AsciiCell)) != 0;
+    }
+    if (ascii_grid_resize(prev, grid->w, grid->h)) SDL_memcpy(prev->cells, grid->cells, count * sizeof(AsciiCell));
+    else prev->w = 0;
+
+    atomic_fetch_add_explicit(&metrics_state.dirty_cells, dirty, memory_order_relaxed);
+    atomic_fetch_add_explicit(&metrics_state.cells, count, memory_order_relaxed);
+    SDL_SetAtomicInt(&metrics_state.dirty_ratio, count ? (int)((Sint64)dirty * DIRTY_SCALE / count) : 0);
+}
+
+Uint64 metrics_begin() {
+    if (!metrics_state.running) return 0;
+    return SDL_max(SDL_GetTicksNS(), 1);
+}
+
+void metrics_end(MetricStage stage, Uint64 begin) {
+    if (begin == 0) return;
+    Uint64 ns = SDL_GetTicksNS() - begin;
+    Histogram *h = &metrics_state.stages[stage];
+    int bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && ns > buckets[bucket] * SDL_NS_PER_SECOND) bucket++;
+    atomic_fetch_add_explicit(&h->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_ns, ns, memory_order_relaxed);
+}
+
+//---Server---
+
+typedef struct {
+    char data[RESPONSE_MAX];
+    size_t len;
+} Response;
+
+static void append(Response *r, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = SDL_vsnprintf(r->data + r->len, sizeof(r->data) - r->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) r->len = SDL_min(r->len + n, sizeof(r->data) - 1);
+}
+
+static void append_gauge(Response *r, const char *name, const char *help, double value) {
+    append(r, "# HELP %s %s\n# TYPE %s gauge\n%s %g\n", name, help, name, name, value);
+}
+
+static void write_metrics(Response *r) {
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        const char *name = counter_info[i].name;
+        append(r, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, counter_info[i].help, name, name,
+               (unsigned long long)atomic_load_explicit(&metrics_state.counters[i], memory_order_relaxed));
+    }
+    append(r, "# HELP jascii_dirty_cells_total Cells that changed between grids.\n"
+              "# TYPE jascii_dirty_cells_total counter\njascii_dirty_cells_total %llu\n",
+           (unsigned long long)atomic_load_explicit(&metrics_state.dirty_cells, memory_order_relaxed));
+    append(r, "# HELP jascii_cells_total Cells computed.\n# TYPE jascii_cells_total counter\njascii_cells_total %llu\n",
+           (unsigned long long)atomic_load_explicit(&metrics_state.cells, memory_order_relaxed));
+
+    append_gauge(r, "jascii_dirty_ratio", "Share of cells that changed in the last grid.",
+                 (double)SDL_GetAtomicInt(&metrics_state.dirty_ratio) / DIRTY_SCALE);
+    append_gauge(r, "jascii_grid_columns", "Ascii grid width in cells.", SDL_GetAtomicInt(&metrics_state.grid_w));
+    append_gauge(r, "jascii_grid_rows", "Ascii grid height in cells.", SDL_GetAtomicInt(&metrics_state.grid_h));
+    append_gauge(r, "jascii_table_index", "Ascii table in use.", SDL_GetAtomicInt(&metrics_state.table_index));
+    append_gauge(r, "jascii_camera_connected", "1 while a camera is open.",
+                 SDL_GetAtomicInt(&metrics_state.camera_connected));
+
+    append(r, "# HELP jascii_stage_seconds Time spent in each stage of the frame loop.\n"
+              "# TYPE jascii_stage_seconds histogram\n");
+    for (int s = 0; s < METRIC_STAGE_COUNT; s++) {
+        Histogram *h = &metrics_state.stages[s];
+        // count first so buckets never add up to more than it
+        Uint64 count = atomic_load_explicit(&h->count, memory_order_relaxed);
+        Uint64 sum_ns = atomic_load_explicit(&h->sum_ns, memory_order_relaxed);
+        Uint64 cumulative = 0;
+        for (int b = 0; b < BUCKET_COUNT - 1; b++) {
+            cumulative += atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+            append(r, "jascii_stage_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n", stage_names[s], buckets[b],
+                   (unsigned long long)SDL_min(cumulative, count));
+        }
+        append(r, "jascii_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", stage_names[s],
+               (unsigned long long)count);
+        append(r, "jascii_stage_seconds_sum{stage=\"%s\"} %.9f\n", stage_names[s], sum_ns / 1e9);
+        append(r, "jascii_stage_seconds_count{stage=\"%s\"} %llu\n", stage_names[s], (unsigned long long)count);
+    }
+}
+
+static void send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        data += n;
+        len -= n;
+    }
+}
+
+// one scrape per connection, they are rare and small
+static void serve(int fd) {
+    char request[REQUEST_MAX];
+    int len = 0;
+    Uint64 deadline = SDL_GetTicks() + REQUEST_TIMEOUT_MS;
+    while (len < REQUEST_MAX - 1) {
+        Uint64 now = SDL_GetTicks();
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (now >= deadline || poll(&pfd, 1, (int)(deadline - now)) <= 0) return;
+        ssize_t n = recv(fd, request + len, REQUEST_MAX - 1 - len, 0);
+        if (n <= 0) return;
+        len += n;
+        request[len] = '\0';
+        if (SDL_strstr(request, "\r\n\r\n")) break;
+    }
+
+    static Response response;
+    response.len = 0;
+    const char *status = "200 OK";
+    if (SDL_strncmp(request, "GET /metrics ", 13) == 0) write_metrics(&response);
+    else {
+        status = "404 Not Found";
+        append(&response, "not found\n");
+    }
+    char header[256];
+    int header_len = SDL_snprintf(header, sizeof(header),
+                                  "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                  "Content-Length: %zu\r\nConnection: close\r\n\r\n", status, response.len);
+    send_all(fd, header, header_len);
+    send_all(fd, response.data, response.len);
+}
+
+static int server_thread(void *data) {
+    (void)data;
+    while (!SDL_GetAtomicInt(&metrics_state.quit)) {
+        struct pollfd pfd = {.fd = metrics_state.listen_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 500) <= 0) continue;
+        int fd = accept(metrics_state.listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        serve(fd);
+        close(fd);
+    }
+    return 0;
+}
+
+bool metrics_start(const char *address) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    const char *colon = SDL_strrchr(address, ':');
+    int port = SDL_atoi(colon ? colon + 1 : address);
+    if (colon) {
+        char host[64];
+        SDL_strlcpy(host, address, SDL_min(sizeof(host), (size_t)(colon - address + 1)));
+        if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+            ERROR("Invalid metrics address %s", address);
+            return false;
+        }
+    }
+    if (port <= 0 || port > 65535) {
+        ERROR("Invalid metrics port %s", address);
+        return false;
+    }
+    addr.sin_port = htons(port);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ERROR("Couldn't create metrics socket");
+        return false;
+    }
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        ERROR("Couldn't listen on %s", address);
+        close(fd);
+        return false;
+    }
+
+    metrics_state.listen_fd = fd;
+    SDL_SetAtomicInt(&metrics_state.quit, 0);
+    metrics_state.running = true;
+    metrics_state.thread = SDL_CreateThread(server_thread, "metrics", NULL);
+    if (metrics_state.thread == NULL) {
+        ERROR("Couldn't create metrics thread\n%s", SDL_GetError());
+        metrics_state.running = false;
+        close(fd);
+        return false;
+    }
+    char host[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr.sin_addr, host, sizeof(host));
+    SDL_Log("Serving metrics on http://%s:%d/metrics", host, port);
+    return true;
+}
+
+void metrics_stop() {
+    if (!metrics_state.running) return;
+    SDL_SetAtomicInt(&metrics_state.quit, 1);
+    SDL_WaitThread(metrics_state.thread, NULL);
+    close(metrics_state.listen_fd);
+    ascii_grid_free(&metrics_state.prev);
+    metrics_state.running = false;
+}
+
+#else
+
+bool metrics_start(const char *address) {
+    (void)address;
+    ERROR("The metrics endpoint is not supported on this platform");
+    return false;
+}
+
+void metrics_add(MetricCounter counter, int n) {
+    (void)counter;
+    (void)n;
+}
+
+void metrics_set_camera(bool connected) { (void)connected; }
+
+void metrics_camera_frame(Uint64 timestamp_ns, int fps) {
+    (void)timestamp_ns;
+    (void)fps;
+}
+
+void metrics_publish_grid(AsciiGrid *grid) { (void)grid; }
+
+Uint64 metrics_begin() { return 0; }
+
+void metrics_end(MetricStage stage, Uint64 begin) {
+    (void)stage;
+    (void)begin;
+}
+
+void metrics_stop() {}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include "ascii.h"
+
+/* Live counters served in the Prometheus text format on GET /metrics.
+   updates are lock free and cost nothing until metrics_start, a single
+   thread answers scrapes.
+*/
+typedef enum {
+    METRIC_FRAMES_CAPTURED,
+    METRIC_FRAMES_RENDERED,
+    METRIC_FRAMES_DROPPED,
+    METRIC_CAMERA_DISCONNECTS,
+    METRIC_CAMERA_RECONNECTS,
+    METRIC_COUNTER_COUNT,
+} MetricCounter;
+
+typedef enum {
+    METRIC_STAGE_SCALE,
+    METRIC_STAGE_COMPUTE,
+    METRIC_STAGE_PUBLISH,
+    METRIC_STAGE_DRAW,
+    METRIC_STAGE_PRESENT,
+    METRIC_STAGE_FRAME, // the whole loop iteration including the frame cap
+    METRIC_STAGE_COUNT,
+} MetricStage;
+
+// address is a port or addr:port, loopback unless an address is given
+bool metrics_start(const char *address);
+void metrics_add(MetricCounter counter, int n);
+void metrics_set_camera(bool connected);
+// counts a captured frame and the frames the camera dropped before it
+void metrics_camera_frame(Uint64 timestamp_ns, int fps);
+// grid size, table and the share of cells that changed since the last grid
+void metrics_publish_grid(AsciiGrid *grid);
+// 0 while metrics are off, same as trace_begin
+Uint64 metrics_begin();
+void metrics_end(MetricStage stage, Uint64 begin);
+void metrics_stop();
+
+#endif
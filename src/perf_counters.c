@@ -0,0 +1,129 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+static const char *counter_names[PERF_COUNTER_COUNT] = {
+    [PERF_CYCLES] = "cycles",
+    [PERF_INSTRUCTIONS] = "instructions",
+    [PERF_CACHE_MISSES] = "cache_misses",
+    [PERF_BRANCH_MISSES] = "branch_misses",
+    [PERF_LLC_LOADS] = "llc_loads",
+};
+
+const char *perf_counter_name(PerfCounter counter) { return counter_names[counter]; }
+
+#ifdef __linux__
+
+static struct {
+    int leader; // -1 while closed
+    int fds[PERF_COUNTER_COUNT];
+    // counters in the order the group reads them
+    PerfCounter order[PERF_COUNTER_COUNT];
+    int count;
+} perf_state = {.leader = -1};
+
+static int open_counter(PerfCounter counter, int group) {
+    struct perf_event_attr attr = {
+        .size = sizeof(attr),
+        .read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+    switch (counter) {
+        case PERF_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_CACHE_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PERF_BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16);
+            break;
+    }
+    // this thread on any cpu
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+bool perf_counters_open() {
+    if (perf_state.leader >= 0) return true;
+    perf_state.count = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        int fd = open_counter(i, perf_state.leader);
+        perf_state.fds[i] = fd;
+        if (fd < 0) continue;
+        if (perf_state.leader < 0) perf_state.leader = fd;
+        perf_state.order[perf_state.count++] = i;
+    }
+    if (perf_state.leader < 0) {
+        ERROR("No hardware counters, check /proc/sys/kernel/perf_event_paranoid");
+        return false;
+    }
+    ioctl(perf_state.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf_state.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        if (perf_state.fds[i] < 0) SDL_Log("Counter %s isn't available", counter_names[i]);
+    return true;
+}
+
+bool perf_counters_has(PerfCounter counter) { return perf_state.leader >= 0 && perf_state.fds[counter] >= 0; }
+
+bool perf_counters_read(PerfCounts *counts) {
+    *counts = (PerfCounts){0};
+    if (perf_state.leader < 0) return false;
+    // nr, time enabled, time running, then a value per counter
+    Uint64 data[3 + PERF_COUNTER_COUNT];
+    ssize_t size = read(perf_state.leader, data, sizeof(data));
+    if (size < (ssize_t)(3 * sizeof(Uint64)) || data[0] != (Uint64)perf_state.count) return false;
+
+    // the kernel time shares counters when there are more groups than it has, scale up to the time enabled
+    double scale = data[2] ? (double)data[1] / data[2] : 0.0;
+    for (int i = 0; i < perf_state.count; i++)
+        counts->values[perf_state.order[i]] = (Uint64)(data[3 + i] * scale);
+    return true;
+}
+
+void perf_counters_close() {
+    for (int i = 0; i < PERF_COUNTER_COUNT && perf_state.leader >= 0; i++)
+        if (perf_state.fds[i] >= 0) close(perf_state.fds[i]);
+    perf_state.leader = -1;
+}
+
+#else
+
+bool perf_counters_open() {
+    ERROR("Hardware counters are only supported on Linux");
+    return false;
+}
+
+bool perf_counters_has(PerfCounter counter) {
+    (void)counter;
+    return false;
+}
+
+bool perf_counters_read(PerfCounts *counts) {
+    *counts = (PerfCounts){0};
+    return false;
+}
+
+void perf_counters_close() {}
+
+#endif
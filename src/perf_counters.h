@@ -0,0 +1,31 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+#include <SDL3/SDL.h>
+
+/* Hardware counters of the calling thread through perf_event_open, user
+   space only so the default perf_event_paranoid allows them. Linux only,
+   counters the CPU or a VM doesn't have are left out.
+*/
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_LLC_LOADS,
+    PERF_COUNTER_COUNT,
+} PerfCounter;
+
+typedef struct {
+    Uint64 values[PERF_COUNTER_COUNT]; // scaled up when the kernel multiplexed them
+} PerfCounts;
+
+// opens the counters of the calling thread, false if none are available
+bool perf_counters_open();
+// whether the counter was opened, its values stay 0 otherwise
+bool perf_counters_has(PerfCounter counter);
+// running totals, subtract two reads for the counts in between
+bool perf_counters_read(PerfCounts *counts);
+void perf_counters_close();
+const char *perf_counter_name(PerfCounter counter);
+
+#endif
@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL.h>
+
+#include "ascii.h"
+#include "quality.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+// every grid width divides the output so cells are whole pixels
+#define OUTPUT_W 960
+#define OUTPUT_H 720
+#define IMAGE_W 640
+#define IMAGE_H 480
+#define GENERATED_IMAGES 4
+#define MAX_IMAGES 16
+#define DEFAULT_ITERATIONS 30
+#define MAX_ITERATIONS 1000
+// SSIM over luma in overlapping windows, the usual constants for 8 bit
+#define SSIM_WINDOW 8
+#define SSIM_STEP 4
+#define SSIM_C1 (0.01 * 255 * 0.01 * 255)
+#define SSIM_C2 (0.03 * 255 * 0.03 * 255)
+// reported for identical images
+#define PSNR_MAX 99.0
+
+#define PLOT_W 800
+#define PLOT_H 500
+#define PLOT_MARGIN 60
+
+static const int widths[] = {32, 64, 96, 160, 240};
+
+static const struct {
+    const char *name;
+    SDL_ScaleMode mode;
+} samplings[] = {
+    {"nearest", SDL_SCALEMODE_NEAREST},
+    {"linear", SDL_SCALEMODE_LINEAR},
+};
+
+#define CONFIG_COUNT (ASCII_MODE_COUNT * SDL_arraysize(samplings) * SDL_arraysize(widths))
+
+typedef struct {
+    char name[64];
+    AsciiMode mode;
+    int sampling;
+    int cols;
+    int rows;
+    Uint64 median_ns;
+    double ssim; // mean over the images
+    double psnr;
+    bool pareto; // nothing else is both faster and better
+} QualityResult;
+
+struct {
+    AsciiContext *ascii;
+    SDL_Renderer *renderer;
+    SDL_Surface *canvas;
+    int iterations;
+
+    SDL_Surface *images[MAX_IMAGES];
+    SDL_Surface *references[MAX_IMAGES]; // images scaled to the output
+    int image_count;
+    QualityResult results[CONFIG_COUNT];
+    int result_count;
+} quality_state = {0};
+
+//---Images---
+
+// smooth shading, hard edges and fine detail, noise would only measure noise
+static SDL_Surface *make_image(int image) {
+    static const Uint8 bars[8][3] = {
+        {235, 235, 235}, {235, 235, 16}, {16, 235, 235}, {16, 235, 16},
+        {235, 16, 235}, {235, 16, 16}, {16, 16, 235}, {16, 16, 16},
+    };
+    SDL_Surface *s = SDL_CreateSurface(IMAGE_W, IMAGE_H, SDL_PIXELFORMAT_RGB24);
+    if (s == NULL) return NULL;
+    for (int y = 0; y < s->h; y++) {
+        Uint8 *p = (Uint8 *)s->pixels + y * s->pitch;
+        for (int x = 0; x < s->w; x++, p += 3) {
+            switch (image) {
+                case 0:
+                    p[0] = x * 255 / (s->w - 1);
+                    p[1] = y * 255 / (s->h - 1);
+                    p[2] = 255 - p[0] / 2;
+                break;
+                case 1: {
+                    // rings getting tighter away from the center
+                    float dx = x - s->w / 2.0f, dy = y - s->h / 2.0f;
+                    float r2 = (dx * dx + dy * dy) / (s->h * 4.0f);
+                    Uint8 v = (Uint8)(127.5f + 127.5f * SDL_sinf(r2));
+                    p[0] = v;
+                    p[1] = v;
+                    p[2] = 255 - v / 2;
+                }
+                break;
+                case 2: {
+                    const Uint8 *bar = bars[x * 8 / s->w];
+                    Uint8 ramp = x * 255 / (s->w - 1);
+                    p[0] = y < s->h / 2 ? bar[0] : ramp;
+                    p[1] = y < s->h / 2 ? bar[1] : ramp;
+                    p[2] = y < s->h / 2 ? bar[2] : ramp;
+                }
+                break;
+                default: {
+                    // a lit sphere over a fine checker
+                    float dx = (x - s->w * 0.6f) / (s->h * 0.35f), dy = (y - s->h * 0.45f) / (s->h * 0.35f);
+                    float d2 = dx * dx + dy * dy;
+                    bool on = ((x / 4) ^ (y / 4)) & 1;
+                    if (d2 < 1.0f) {
+                        float light = SDL_max(0.0f, 0.6f * SDL_sqrtf(1.0f - d2) - 0.4f * dx - 0.3f * dy);
+                        p[0] = (Uint8)(40 + 215 * SDL_min(light, 1.0f));
+                        p[1] = (Uint8)(20 + 120 * SDL_min(light, 1.0f));
+                        p[2] = 30;
+                    } else {
+                        p[0] = p[1] = p[2] = on ? 180 : 60;
+                    }
+                }
+                break;
+            }
+        }
+    }
+    return s;
+}
+
+static SDL_Surface *load_image(const char *path) {
+    SDL_Surface *bmp = SDL_LoadBMP(path);
+    if (bmp == NULL) {
+        ERROR("Couldn't load %s\n%s", path, SDL_GetError());
+        return NULL;
+    }
+    SDL_Surface *s = SDL_ConvertSurface(bmp, SDL_PIXELFORMAT_RGB24);
+    SDL_DestroySurface(bmp);
+    return s;
+}
+
+//---Scores---
+
+static float *luma_plane(SDL_Surface *s) {
+    float *plane = malloc((size_t)s->w * s->h * sizeof(float));
+    if (plane == NULL) return NULL;
+    for (int y = 0; y < s->h; y++) {
+        const Uint8 *p = (const Uint8 *)s->pixels + y * s->pitch;
+        for (int x = 0; x < s->w; x++, p += 3) plane[y * s->w + x] = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+    }
+    return plane;
+}
+
+// both RGB24 of the same size, -1 if out of memory
+static double ssim(SDL_Surface *a, SDL_Surface *b) {
+    float *la = luma_plane(a);
+    float *lb = luma_plane(b);
+    double total = 0.0;
+    int windows = 0;
+    for (int y0 = 0; la && lb && y0 + SSIM_WINDOW <= a->h; y0 += SSIM_STEP) {
+        for (int x0 = 0; x0 + SSIM_WINDOW <= a->w; x0 += SSIM_STEP) {
+            double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+            for (int y = y0; y < y0 + SSIM_WINDOW; y++) {
+                for (int x = x0; x < x0 + SSIM_WINDOW; x++) {
+                    double va = la[y * a->w + x], vb = lb[y * a->w + x];
+                    sa += va;
+                    sb += vb;
+                    saa += va * va;
+                    sbb += vb * vb;
+                    sab += va * vb;
+                }
+            }
+            double n = SSIM_WINDOW * SSIM_WINDOW;
+            double ma = sa / n, mb = sb / n;
+            double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+            total += ((2 * ma * mb + SSIM_C1) * (2 * cov + SSIM_C2)) /
+                     ((ma * ma + mb * mb + SSIM_C1) * (va + vb + SSIM_C2));
+            windows++;
+        }
+    }
+    bool ok = la && lb;
+    free(la);
+    free(lb);
+    return ok ? total / SDL_max(windows, 1) : -1.0;
+}
+
+static double psnr(SDL_Surface *a, SDL_Surface *b) {
+    Uint64 sum = 0;
+    for (int y = 0; y < a->h; y++) {
+        const Uint8 *pa = (const Uint8 *)a->pixels + y * a->pitch;
+        const Uint8 *pb = (const Uint8 *)b->pixels + y * b->pitch;
+        for (int x = 0; x < a->w * 3; x++) {
+            int d = pa[x] - pb[x];
+            sum += d * d;
+        }
+    }
+    double mse = (double)sum / ((double)a->w * a->h * 3);
+    return mse > 0 ? SDL_min(10.0 * SDL_log10(255.0 * 255.0 / mse), PSNR_MAX) : PSNR_MAX;
+}
+
+//---Runs---
+
+static int compare_ns(const void *a, const void *b) {
+    Uint64 x = *(const Uint64 *)a;
+    Uint64 y = *(const Uint64 *)b;
+    return x < y ? -1 : x > y;
+}
+
+// sampling, compute and draw of one frame, what the live loop does
+static void render(SDL_Surface *image, SDL_Surface *frame, AsciiGrid *grid, AsciiMode mode, SDL_ScaleMode sampling) {
+    SDL_FRect rect = {0, 0, OUTPUT_W, OUTPUT_H};
+    SDL_BlitSurfaceScaled(image, NULL, frame, NULL, sampling);
+    ascii_compute_mode(quality_state.ascii, mode, grid, frame, 0);
+    SDL_SetRenderDrawColor(quality_state.renderer, 0, 0, 0, 255);
+    SDL_RenderClear(quality_state.renderer);
+    ascii_draw(quality_state.ascii, &rect, grid);
+    SDL_FlushRenderer(quality_state.renderer);
+}
+
+static bool evaluate(QualityResult *r) {
+    int sx, sy;
+    ascii_mode_scale(r->mode, &sx, &sy);
+    SDL_ScaleMode sampling = samplings[r->sampling].mode;
+    ascii_update_font_size(quality_state.ascii, ascii_cell_font_size(quality_state.ascii, (float)OUTPUT_H / r->rows));
+
+    SDL_Surface *frame = SDL_CreateSurface(r->cols * sx, r->rows * sy, SDL_PIXELFORMAT_RGB24);
+    Uint64 *samples = malloc(quality_state.iterations * sizeof(Uint64));
+    AsciiGrid grid = {0};
+    bool ok = frame && samples && ascii_grid_resize(&grid, r->cols, r->rows);
+
+    for (int i = 0; ok && i < quality_state.image_count; i++) {
+        render(quality_state.images[i], frame, &grid, r->mode, sampling);
+        SDL_Surface *out = SDL_ConvertSurface(quality_state.canvas, SDL_PIXELFORMAT_RGB24);
+        double s = out ? ssim(out, quality_state.references[i]) : -1.0;
+        ok = s >= 0.0;
+        if (ok) {
+            r->ssim += s / quality_state.image_count;
+            r->psnr += psnr(out, quality_state.references[i]) / quality_state.image_count;
+        }
+        SDL_DestroySurface(out);
+    }
+
+    for (int i = 0; ok && i < quality_state.iterations; i++) {
+        Uint64 t = SDL_GetTicksNS();
+        render(quality_state.images[i % quality_state.image_count], frame, &grid, r->mode, sampling);
+        samples[i] = SDL_GetTicksNS() - t;
+    }
+    if (ok) {
+        SDL_qsort(samples, quality_state.iterations, sizeof(Uint64), compare_ns);
+        r->median_ns = samples[quality_state.iterations / 2];
+        SDL_Log("%-24s %9.1f us  ssim %.4f  psnr %5.2f dB", r->name, r->median_ns / 1e3, r->ssim, r->psnr);
+    }
+
+    SDL_DestroySurface(frame);
+    free(samples);
+    ascii_grid_free(&grid);
+    return ok;
+}
+
+static void mark_pareto() {
+    for (int i = 0; i < quality_state.result_count; i++) {
+        QualityResult *r = &quality_state.results[i];
+        r->pareto = true;
+        for (int k = 0; k < quality_state.result_count && r->pareto; k++) {
+            QualityResult *o = &quality_state.results[k];
+            bool dominates = o->median_ns <= r->median_ns && o->ssim >= r->ssim &&
+                             (o->median_ns < r->median_ns || o->ssim > r->ssim);
+            if (dominates) r->pareto = false;
+        }
+    }
+}
+
+//---Output---
+
+static bool write_json(FILE *out) {
+    fprintf(out, "{\n  \"output\": \"%dx%d\",\n  \"images\": %d,\n  \"iterations\": %d,\n  \"results\": [\n",
+            OUTPUT_W, OUTPUT_H, quality_state.image_count, quality_state.iterations);
+    for (int i = 0; i < quality_state.result_count; i++) {
+        QualityResult *r = &quality_state.results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"mode\": \"%s\", \"sampling\": \"%s\", \"cols\": %d, \"rows\": %d, "
+                     "\"median_ns\": %llu, \"fps\": %.1f, \"ssim\": %.5f, \"psnr\": %.3f, \"pareto\": %s}%s\n",
+                r->name, ascii_mode_name(r->mode), samplings[r->sampling].name, r->cols, r->rows,
+                (unsigned long long)r->median_ns, r->median_ns ? 1e9 / r->median_ns : 0.0, r->ssim, r->psnr,
+                r->pareto ? "true" : "false", i < quality_state.result_count - 1 ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    return fflush(out) == 0 && !ferror(out);
+}
+
+/* SSIM over frame time on a log scale, a color per mode, linear sampling
+   filled, the Pareto front connected and labeled
+*/
+static bool write_plot(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) return false;
+    static const char *colors[ASCII_MODE_COUNT] = {"#1f77b4", "#d62728", "#2ca02c"};
+
+    double min_t = 1e300, max_t = 0, min_s = 1, max_s = 0;
+    for (int i = 0; i < quality_state.result_count; i++) {
+        QualityResult *r = &quality_state.results[i];
+        double t = SDL_log10(SDL_max(r->median_ns, 1) / 1e6);
+        min_t = SDL_min(min_t, t);
+        max_t = SDL_max(max_t, t);
+        min_s = SDL_min(min_s, r->ssim);
+        max_s = SDL_max(max_s, r->ssim);
+    }
+    // some room around the points and no zero ranges
+    min_t -= 0.05, max_t += 0.05, min_s -= 0.01, max_s += 0.01;
+    double plot_w = PLOT_W - 2 * PLOT_MARGIN, plot_h = PLOT_H - 2 * PLOT_MARGIN;
+#define PLOT_X(ns) (PLOT_MARGIN + (SDL_log10(SDL_max(ns, 1) / 1e6) - min_t) / (max_t - min_t) * plot_w)
+#define PLOT_Y(s) (PLOT_H - PLOT_MARGIN - ((s) - min_s) / (max_s - min_s) * plot_h)
+
+    fprintf(out, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" font-family=\"monospace\" "
+                 "font-size=\"11\">\n<rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n", PLOT_W, PLOT_H);
+    fprintf(out, "<rect x=\"%d\" y=\"%d\" width=\"%.0f\" height=\"%.0f\" fill=\"none\" stroke=\"black\"/>\n",
+            PLOT_MARGIN, PLOT_MARGIN, plot_w, plot_h);
+    fprintf(out, "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\">frame time (ms, log scale)</text>\n", PLOT_W / 2,
+            PLOT_H - PLOT_MARGIN / 3);
+    fprintf(out, "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\" transform=\"rotate(-90 %d %d)\">SSIM</text>\n",
+            PLOT_MARGIN / 3, PLOT_H / 2, PLOT_MARGIN / 3, PLOT_H / 2);
+    fprintf(out, "<text x=\"%d\" y=\"%d\">%.3f ms</text><text x=\"%d\" y=\"%d\" text-anchor=\"end\">%.3f ms</text>\n",
+            PLOT_MARGIN, PLOT_H - PLOT_MARGIN + 14, SDL_pow(10, min_t), PLOT_W - PLOT_MARGIN,
+            PLOT_H - PLOT_MARGIN + 14, SDL_pow(10, max_t));
+    fprintf(out, "<text x=\"%d\" y=\"%d\" text-anchor=\"end\">%.3f</text><text x=\"%d\" y=\"%d\" "
+                 "text-anchor=\"end\">%.3f</text>\n",
+            PLOT_MARGIN - 4, PLOT_H - PLOT_MARGIN, min_s, PLOT_MARGIN - 4, PLOT_MARGIN + 10, max_s);
+    for (int mode = 0; mode < ASCII_MODE_COUNT; mode++) {
+        fprintf(out, "<text x=\"%d\" y=\"%d\" fill=\"%s\">%s</text>\n", PLOT_MARGIN + mode * 80, PLOT_MARGIN - 10,
+                colors[mode], ascii_mode_name(mode));
+    }
+
+    // the front in order of frame time
+    fprintf(out, "<polyline fill=\"none\" stroke=\"gray\" stroke-dasharray=\"4 3\" points=\"");
+    for (Uint64 last = 0;;) {
+        QualityResult *next = NULL;
+        for (int i = 0; i < quality_state.result_count; i++) {
+            QualityResult *r = &quality_state.results[i];
+            if (r->pareto && r->median_ns > last && (next == NULL || r->median_ns < next->median_ns)) next = r;
+        }
+        if (next == NULL) break;
+        fprintf(out, "%.1f,%.1f ", PLOT_X(next->median_ns), PLOT_Y(next->ssim));
+        last = next->median_ns;
+    }
+    fprintf(out, "\"/>\n");
+
+    for (int i = 0; i < quality_state.result_count; i++) {
+        QualityResult *r = &quality_state.results[i];
+        double x = PLOT_X(r->median_ns), y = PLOT_Y(r->ssim);
+        fprintf(out, "<circle cx=\"%.1f\" cy=\"%.1f\" r=\"4\" stroke=\"%s\" fill=\"%s\"><title>%s %.3f ms ssim %.4f "
+                     "psnr %.2f</title></circle>\n",
+                x, y, colors[r->mode], r->sampling ? colors[r->mode] : "white", r->name, r->median_ns / 1e6, r->ssim,
+                r->psnr);
+        if (r->pareto) fprintf(out, "<text x=\"%.1f\" y=\"%.1f\">%s</text>\n", x + 6, y - 6, r->name);
+    }
+#undef PLOT_X
+#undef PLOT_Y
+    fprintf(out, "</svg>\n");
+    return fclose(out) == 0;
+}
+
+static void print_usage() {
+    SDL_Log("Usage: j-ascii quality [options]");
+    SDL_Log("  -f <.tbl file>     ascii table file");
+    SDL_Log("  -i <image.bmp>     score this image instead of the generated ones, can be repeated");
+    SDL_Log("  -o <out.json>      write results here instead of stdout");
+    SDL_Log("  -p <plot.svg>      plot SSIM against frame time");
+    SDL_Log("  -n <iterations>    timed frames per configuration (default %d)", DEFAULT_ITERATIONS);
+}
+
+int quality_main(int argc, char *argv[]) {
+    char *table_file = NULL;
+    char *out_path = NULL;
+    char *plot_path = NULL;
+    bool failed = false;
+    quality_state.iterations = DEFAULT_ITERATIONS;
+
+    // args
+    for (int i = 0; i < argc; i++) {
+        char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_usage();
+            return 0;
+        } else if (strcmp(arg, "-f") == 0 && has_value) {
+            table_file = argv[++i];
+        } else if (strcmp(arg, "-i") == 0 && has_value) {
+            if (quality_state.image_count == MAX_IMAGES) {
+                ERROR("At most %d images", MAX_IMAGES);
+                failed = true;
+                break;
+            }
+            SDL_Surface *image = load_image(argv[++i]);
+            if (image == NULL) {
+                failed = true;
+                break;
+            }
+            quality_state.images[quality_state.image_count++] = image;
+        } else if (strcmp(arg, "-o") == 0 && has_value) {
+            out_path = argv[++i];
+        } else if (strcmp(arg, "-p") == 0 && has_value) {
+            plot_path = argv[++i];
+        } else if (strcmp(arg, "-n") == 0 && has_value) {
+            quality_state.iterations = SDL_atoi(argv[++i]);
+        } else {
+            ERROR("Invalid argument %s", arg);
+            print_usage();
+            failed = true;
+            break;
+        }
+    }
+    if (!failed && (quality_state.iterations <= 0 || quality_state.iterations > MAX_ITERATIONS)) {
+        ERROR("Iterations have to be between 1 and %d", MAX_ITERATIONS);
+        failed = true;
+    }
+
+    for (int i = 0; !failed && quality_state.image_count == 0 && i < GENERATED_IMAGES; i++) {
+        quality_state.images[i] = make_image(i);
+        if (quality_state.images[i] == NULL) failed = true;
+    }
+    if (!failed && quality_state.image_count == 0) quality_state.image_count = GENERATED_IMAGES;
+    // the reference is the best the output size can show of the source
+    for (int i = 0; !failed && i < quality_state.image_count; i++) {
+        SDL_Surface *ref = SDL_CreateSurface(OUTPUT_W, OUTPUT_H, SDL_PIXELFORMAT_RGB24);
+        quality_state.references[i] = ref;
+        if (ref == NULL || !SDL_BlitSurfaceScaled(quality_state.images[i], NULL, ref, NULL, SDL_SCALEMODE_LINEAR))
+            failed = true;
+    }
+
+    // headless
+    if (!failed) {
+        quality_state.canvas = SDL_CreateSurface(OUTPUT_W, OUTPUT_H, SDL_PIXELFORMAT_XRGB8888);
+        quality_state.renderer = quality_state.canvas ? SDL_CreateSoftwareRenderer(quality_state.canvas) : NULL;
+        if (quality_state.renderer)
+            quality_state.ascii = ascii_create(quality_state.renderer, (float)OUTPUT_W / widths[0], table_file);
+        if (quality_state.ascii == NULL) {
+            ERROR("Failed to create software renderer\n%s", SDL_GetError());
+            failed = true;
+        }
+    }
+
+    for (int mode = 0; !failed && mode < ASCII_MODE_COUNT; mode++) {
+        for (int s = 0; !failed && s < (int)SDL_arraysize(samplings); s++) {
+            for (int w = 0; !failed && w < (int)SDL_arraysize(widths); w++) {
+                QualityResult *r = &quality_state.results[quality_state.result_count++];
+                *r = (QualityResult){.mode = mode, .sampling = s, .cols = widths[w]};
+                // cells shaped like the glyphs, like the live view
+                ascii_grid_font_size(quality_state.ascii, r->cols, (float)OUTPUT_H / OUTPUT_W, OUTPUT_H, &r->rows);
+                SDL_snprintf(r->name, sizeof(r->name), "%s/%s/%dx%d", ascii_mode_name(mode), samplings[s].name,
+                             r->cols, r->rows);
+                failed = !evaluate(r);
+            }
+        }
+    }
+
+    if (!failed) {
+        mark_pareto();
+        SDL_Log("Pareto front:");
+        for (int i = 0; i < quality_state.result_count; i++) {
+            QualityResult *r = &quality_state.results[i];
+            if (r->pareto) SDL_Log("  %-24s %9.1f us  ssim %.4f", r->name, r->median_ns / 1e3, r->ssim);
+        }
+
+        FILE *out = out_path ? fopen(out_path, "w") : stdout;
+        if (out == NULL || !write_json(out)) {
+            ERROR("Couldn't write %s", out_path ? out_path : "results");
+            failed = true;
+        }
+        if (out && out != stdout) fclose(out);
+        if (plot_path && !write_plot(plot_path)) {
+            ERROR("Couldn't write %s", plot_path);
+            failed = true;
+        }
+    }
+
+    // cleanup
+    for (int i = 0; i < MAX_IMAGES; i++) {
+        SDL_DestroySurface(quality_state.images[i]);
+        SDL_DestroySurface(quality_state.references[i]);
+    }
+    ascii_destroy(quality_state.ascii);
+    if (quality_state.renderer) SDL_DestroyRenderer(quality_state.renderer);
+    SDL_DestroySurface(quality_state.canvas);
+    SDL_Quit();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+#ifndef QUALITY_H
+#define QUALITY_H
+
+/* Quality versus speed: j-ascii quality [options]
+   renders reference images through every mode, sampling filter and grid
+   width on the software renderer, scores the output with SSIM and PSNR
+   against the source scaled to the output size and times the frame.
+   argv starts after the "quality" argument.
+*/
+int quality_main(int argc, char *argv[]);
+
+#endif
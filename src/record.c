@@ -0,0 +1,161 @@
+#include <stdio.h>
+
+#include "record.h"
+#include "trace.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+// frames waiting for the writer before new ones are dropped
+#define WRITE_QUEUE_LEN 8
+
+struct {
+    bool active;
+    FILE *file;
+    int w, h;
+    int dropped;
+    AsciiContext *ascii; // the writer's own, its glyphs are baked on the writer thread
+
+    SDL_Thread *writer;
+    SDL_Mutex *lock;
+    SDL_Condition *cond;
+    AsciiGrid queue[WRITE_QUEUE_LEN]; // the head is kept until it was written
+    int queue_head;
+    int queue_count;
+    bool done;
+    bool failed;
+    int written;
+} rec_state = {0};
+
+// rasterize at the font size that fills a cell of the recording
+static bool raster_grid(SDL_Surface *frame, AsciiGrid *grid) {
+    AsciiContext *ctx = rec_state.ascii;
+    ascii_update_font_size(ctx, ascii_cell_font_size(ctx, (float)frame->h / grid->h));
+    if (!ascii_bake_glyphs(ctx, grid->table_index)) return false;
+    ascii_raster(ctx, frame, grid);
+    return true;
+}
+
+static int writer_thread(void *data) {
+    (void)data;
+    int w = rec_state.w;
+    int h = rec_state.h;
+    size_t yuv_size = (size_t)w * h * 3 / 2;
+    Uint8 *yuv = SDL_malloc(yuv_size);
+    SDL_Surface *frame = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGB24);
+    trace_thread_name("record");
+
+    SDL_LockMutex(rec_state.lock);
+    while (true) {
+        if (rec_state.queue_count == 0) {
+            if (rec_state.done) break;
+            SDL_WaitCondition(rec_state.cond, rec_state.lock);
+            continue;
+        }
+        AsciiGrid *grid = &rec_state.queue[rec_state.queue_head];
+        SDL_UnlockMutex(rec_state.lock);
+
+        Uint64 t = trace_begin();
+        bool ok = yuv && frame && raster_grid(frame, grid) &&
+                  SDL_ConvertPixelsAndColorspace(w, h, frame->format, SDL_COLORSPACE_SRGB, 0,
+                                                 frame->pixels, frame->pitch,
+                                                 SDL_PIXELFORMAT_IYUV, SDL_COLORSPACE_BT601_LIMITED, 0,
+                                                 yuv, w);
+        ok = ok && fputs("FRAME\n", rec_state.file) >= 0 &&
+             fwrite(yuv, 1, yuv_size, rec_state.file) == yuv_size;
+        trace_end("record write", t);
+
+        SDL_LockMutex(rec_state.lock);
+        rec_state.queue_head = (rec_state.queue_head + 1) % WRITE_QUEUE_LEN;
+        rec_state.queue_count--;
+        if (ok) rec_state.written++;
+        else rec_state.failed = true;
+    }
+    SDL_UnlockMutex(rec_state.lock);
+
+    SDL_DestroySurface(frame);
+    SDL_free(yuv);
+    return 0;
+}
+
+bool record_start(const char *path, const char *table_file, int w, int h, int fps) {
+    if (rec_state.active) return true;
+
+    // 4:2:0 needs even dimensions
+    w &= ~1;
+    h &= ~1;
+    if (w <= 0 || h <= 0) return false;
+
+    // same tables as the live view, so table indices of its grids match
+    AsciiContext *ascii = ascii_create(NULL, DEFAULT_RES, table_file);
+    if (ascii == NULL) return false;
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        ERROR("Could not open %s for recording", path);
+        ascii_destroy(ascii);
+        return false;
+    }
+    fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", w, h, fps);
+
+    rec_state = (typeof(rec_state)){0};
+    rec_state.file = file;
+    rec_state.w = w;
+    rec_state.h = h;
+    rec_state.ascii = ascii;
+    rec_state.lock = SDL_CreateMutex();
+    rec_state.cond = SDL_CreateCondition();
+    rec_state.writer = rec_state.lock && rec_state.cond ? SDL_CreateThread(writer_thread, "record", NULL) : NULL;
+    if (rec_state.writer == NULL) {
+        ERROR("Couldn't start the recording writer\n%s", SDL_GetError());
+        SDL_DestroyCondition(rec_state.cond);
+        SDL_DestroyMutex(rec_state.lock);
+        ascii_destroy(ascii);
+        fclose(file);
+        remove(path);
+        rec_state = (typeof(rec_state)){0};
+        return false;
+    }
+    rec_state.active = true;
+    SDL_Log("Recording to %s", path);
+    return true;
+}
+
+void record_capture(AsciiGrid *grid) {
+    if (!rec_state.active) return;
+
+    // only the cells are copied, the writer rasterizes them
+    SDL_LockMutex(rec_state.lock);
+    AsciiGrid *slot = &rec_state.queue[(rec_state.queue_head + rec_state.queue_count) % WRITE_QUEUE_LEN];
+    if (rec_state.queue_count == WRITE_QUEUE_LEN || !ascii_grid_resize(slot, grid->w, grid->h)) {
+        rec_state.dropped++;
+    } else {
+        SDL_memcpy(slot->cells, grid->cells, grid->w * grid->h * sizeof(AsciiCell));
+        slot->table_index = grid->table_index;
+        rec_state.queue_count++;
+        SDL_SignalCondition(rec_state.cond);
+    }
+    SDL_UnlockMutex(rec_state.lock);
+}
+
+void record_stop() {
+    if (!rec_state.active) return;
+    rec_state.active = false;
+
+    SDL_LockMutex(rec_state.lock);
+    rec_state.done = true;
+    SDL_SignalCondition(rec_state.cond);
+    SDL_UnlockMutex(rec_state.lock);
+    SDL_WaitThread(rec_state.writer, NULL);
+
+    fclose(rec_state.file);
+    ascii_destroy(rec_state.ascii);
+    rec_state.ascii = NULL;
+    for (int i = 0; i < WRITE_QUEUE_LEN; i++) ascii_grid_free(&rec_state.queue[i]);
+    SDL_DestroyCondition(rec_state.cond);
+    SDL_DestroyMutex(rec_state.lock);
+    if (rec_state.failed) ERROR("Recording failed to write some frames");
+    SDL_Log("Recording stopped, %d frames written, %d dropped", rec_state.written, rec_state.dropped);
+}
+
+bool record_active() { return rec_state.active; }
+
+int record_dropped() { return rec_state.dropped; }
@@ -0,0 +1,18 @@
+#ifndef RECORD_H
+#define RECORD_H
+#include "ascii.h"
+
+/* Y4M recording of the ascii view.
+   the render loop only copies each grid, a writer thread rasterizes it
+   with ascii_raster into w x h, converts and writes it. frames are
+   dropped (and counted) if the writer can't keep up. table_file is
+   loaded again for the writer's own context
+*/
+bool record_start(const char *path, const char *table_file, int w, int h, int fps);
+// call with every computed grid
+void record_capture(AsciiGrid *grid);
+void record_stop();
+bool record_active();
+int record_dropped();
+
+#endif
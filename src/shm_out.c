@@ -0,0 +1,155 @@
+#include <SDL3/SDL.h>
+
+#include "shm_out.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+#define SHM_SLOTS 4
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "jascii_shm.h"
+
+SDL_COMPILE_TIME_ASSERT(cell_layout, sizeof(AsciiCell) == sizeof(JAsciiShmCell));
+
+struct {
+    JAsciiShmHeader *header;
+    size_t size;
+    char *name;
+    int max_cells;
+    uint64_t frame;
+} shm_state = {0};
+
+// a new ring under name with slots of max_cells, NULL on failure
+static JAsciiShmHeader *shm_create(const char *name, int max_cells, size_t *out_size) {
+    size_t slot_size = sizeof(JAsciiShmSlot) + max_cells * sizeof(JAsciiShmCell);
+    slot_size = (slot_size + 63) & ~(size_t)63;
+    size_t size = JASCII_SHM_HEADER_SIZE + SHM_SLOTS * slot_size;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        ERROR("Couldn't create shared memory %s", name);
+        return NULL;
+    }
+    if (ftruncate(fd, size) < 0) {
+        ERROR("Couldn't size shared memory %s", name);
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        ERROR("Couldn't map shared memory %s", name);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // readers check the magic last
+    JAsciiShmHeader *header = mem;
+    SDL_memset(mem, 0, size);
+    header->version = JASCII_SHM_VERSION;
+    header->slot_count = SHM_SLOTS;
+    header->max_cells = max_cells;
+    header->slot_size = slot_size;
+    atomic_store_explicit(&header->latest, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    header->magic = JASCII_SHM_MAGIC;
+    *out_size = size;
+    return header;
+}
+
+bool shm_out_open(const char *name, int max_cells) {
+    size_t size;
+    JAsciiShmHeader *header = shm_create(name, max_cells, &size);
+    if (header == NULL) return false;
+    shm_state.header = header;
+    shm_state.size = size;
+    shm_state.name = SDL_strdup(name);
+    shm_state.max_cells = max_cells;
+    shm_state.frame = 0;
+    SDL_Log("Publishing ascii frames to shared memory %s", name);
+    return true;
+}
+
+/* a grid that doesn't fit moves to a larger ring under the same name.
+   readers still mapping the old one see it replaced and reopen, frame
+   numbers carry on. stops publishing if the new ring can't be made
+*/
+static bool shm_grow(int cells) {
+    int max_cells = SDL_max(cells, SDL_min(shm_state.max_cells * 2, LIMIT_UPPER * LIMIT_UPPER));
+    shm_unlink(shm_state.name);
+    size_t size;
+    JAsciiShmHeader *header = shm_create(shm_state.name, max_cells, &size);
+    atomic_store_explicit(&shm_state.header->replaced, 1, memory_order_release);
+    munmap(shm_state.header, shm_state.size);
+    shm_state.header = header;
+    shm_state.size = size;
+    if (header == NULL) {
+        ERROR("Stopped publishing to shared memory %s", shm_state.name);
+        SDL_free(shm_state.name);
+        shm_state.name = NULL;
+        return false;
+    }
+    shm_state.max_cells = max_cells;
+    SDL_Log("Shared memory %s grew to %d cells", shm_state.name, max_cells);
+    return true;
+}
+
+void shm_out_publish(AsciiContext *ctx, AsciiGrid *grid) {
+    JAsciiShmHeader *header = shm_state.header;
+    if (header == NULL) return;
+    if (grid->w * grid->h > shm_state.max_cells && !shm_grow(grid->w * grid->h)) return;
+    header = shm_state.header;
+
+    uint64_t frame = ++shm_state.frame;
+    JAsciiShmSlot *slot = JASCII_SHM_SLOT(header, frame % SHM_SLOTS);
+
+    // seqlock write, odd while the slot is inconsistent
+    uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    int table_len = 0;
+    const Uint32 *table = ascii_get_table(ctx, grid->table_index, &table_len);
+    table_len = SDL_min(table_len, JASCII_SHM_TABLE_LEN);
+    slot->frame = frame;
+    slot->w = grid->w;
+    slot->h = grid->h;
+    slot->table_len = table_len;
+    SDL_memcpy(slot->table, table, table_len * sizeof(Uint32));
+    // AsciiCell and JAsciiShmCell share the same layout
+    SDL_memcpy(JASCII_SHM_CELLS(slot), grid->cells, grid->w * grid->h * sizeof(AsciiCell));
+
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+    atomic_store_explicit(&header->latest, frame, memory_order_release);
+}
+
+void shm_out_close() {
+    if (shm_state.header == NULL) return;
+    munmap(shm_state.header, shm_state.size);
+    shm_unlink(shm_state.name);
+    SDL_free(shm_state.name);
+    shm_state.header = NULL;
+}
+
+#else
+
+bool shm_out_open(const char *name, int max_cells) {
+    (void)name;
+    (void)max_cells;
+    ERROR("Shared memory output is not supported on this platform");
+    return false;
+}
+
+void shm_out_publish(AsciiContext *ctx, AsciiGrid *grid) {
+    (void)ctx;
+    (void)grid;
+}
+
+void shm_out_close() {}
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef SHM_OUT_H
+#define SHM_OUT_H
+#include "ascii.h"
+
+/* Shared memory output, see reader/jascii_shm.h for the layout.
+   publishing never waits on readers. a grid over max_cells replaces the
+   ring with a larger one
+*/
+bool shm_out_open(const char *name, int max_cells);
+void shm_out_publish(AsciiContext *ctx, AsciiGrid *grid);
+void shm_out_close();
+
+#endif
@@ -0,0 +1,60 @@
+#include "stream.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <sys/socket.h>
+
+StreamMessage *stream_message_create(const void *data, size_t len, bool key) {
+    StreamMessage *msg = SDL_malloc(sizeof(StreamMessage) + len);
+    if (msg == NULL) return NULL;
+    SDL_SetAtomicInt(&msg->refs, 1);
+    msg->key = key;
+    msg->tag = 0;
+    msg->len = len;
+    if (data) SDL_memcpy(msg->data, data, len);
+    return msg;
+}
+
+void stream_message_unref(StreamMessage *msg) {
+    if (SDL_AddAtomicInt(&msg->refs, -1) == 1) SDL_free(msg);
+}
+
+bool stream_queue_push(StreamQueue *queue, StreamMessage *msg, size_t max_bytes) {
+    if (queue->count == STREAM_QUEUE_LEN || queue->bytes + msg->len > max_bytes) return false;
+    SDL_AddAtomicInt(&msg->refs, 1);
+    queue->items[(queue->head + queue->count) % STREAM_QUEUE_LEN] = msg;
+    queue->count++;
+    queue->bytes += msg->len;
+    return true;
+}
+
+void stream_queue_clear(StreamQueue *queue, bool keep_partial) {
+    // a partially sent message has to finish or the stream breaks
+    int keep = keep_partial && queue->head_sent > 0 ? 1 : 0;
+    for (int i = keep; i < queue->count; i++) {
+        StreamMessage *msg = queue->items[(queue->head + i) % STREAM_QUEUE_LEN];
+        queue->bytes -= msg->len;
+        stream_message_unref(msg);
+    }
+    queue->count = keep;
+    if (!keep) queue->head_sent = 0;
+}
+
+bool stream_queue_flush(StreamQueue *queue, int fd) {
+    while (queue->count > 0) {
+        StreamMessage *msg = queue->items[queue->head];
+        ssize_t n = send(fd, msg->data + queue->head_sent, msg->len - queue->head_sent, MSG_NOSIGNAL);
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+        queue->head_sent += n;
+        if (queue->head_sent < msg->len) return true;
+
+        queue->head_sent = 0;
+        queue->bytes -= msg->len;
+        queue->head = (queue->head + 1) % STREAM_QUEUE_LEN;
+        queue->count--;
+        stream_message_unref(msg);
+    }
+    return true;
+}
+
+#endif
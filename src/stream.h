@@ -0,0 +1,38 @@
+#ifndef STREAM_H
+#define STREAM_H
+#include <SDL3/SDL.h>
+
+/* Shared pieces of the network outputs.
+   a message is encoded once and queued on any number of clients,
+   each client owns a queue of references it drains with non blocking sends.
+*/
+
+typedef struct {
+    SDL_AtomicInt refs;
+    bool key;   // decodable without earlier messages
+    Uint32 tag; // output specific, e.g. the grid size
+    size_t len;
+    char data[];
+} StreamMessage;
+
+StreamMessage *stream_message_create(const void *data, size_t len, bool key);
+void stream_message_unref(StreamMessage *msg);
+
+#define STREAM_QUEUE_LEN 32
+
+typedef struct {
+    StreamMessage *items[STREAM_QUEUE_LEN];
+    int head;
+    int count;
+    size_t bytes;
+    size_t head_sent;
+} StreamQueue;
+
+// false if the message doesn't fit in max_bytes or the queue is full
+bool stream_queue_push(StreamQueue *queue, StreamMessage *msg, size_t max_bytes);
+// drop queued messages, a partially sent one is kept if keep_partial
+void stream_queue_clear(StreamQueue *queue, bool keep_partial);
+// send as much as possible, returns false on a socket error
+bool stream_queue_flush(StreamQueue *queue, int fd);
+
+#endif
@@ -0,0 +1,157 @@
+#include <SDL3/SDL.h>
+
+#include "table_watch.h"
+#include "trace.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// editors write a file in several steps, wait for it to settle
+#define SETTLE_MS 50
+#define QUIT_POLL_MS 200
+
+static struct {
+    bool running;
+    SDL_Thread *thread;
+    SDL_AtomicInt quit;
+    int fd;
+    char *path;
+    const char *name; // points into path
+
+    SDL_AtomicU32 font_size; // float bits, 0 until the first poll
+    void *ready; // AsciiContext waiting to be picked up
+} watch_state = {.fd = -1};
+
+// true when one of the events is for the table file
+static bool read_events() {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool match = false;
+    ssize_t len;
+    while ((len = read(watch_state.fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len;) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            if (event->len > 0 && SDL_strcmp(event->name, watch_state.name) == 0) match = true;
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return match;
+}
+
+// tables and every table's glyphs are prepared here, like at startup
+static void reload() {
+    Uint32 bits = SDL_GetAtomicU32(&watch_state.font_size);
+    float font_size;
+    SDL_memcpy(&font_size, &bits, sizeof(font_size));
+
+    Uint64 start = SDL_GetTicksNS();
+    Uint64 t = trace_begin();
+    AsciiContext *ctx = ascii_create(NULL, font_size, watch_state.path);
+    if (ctx == NULL) {
+        ERROR("Couldn't reload %s", watch_state.path);
+        return;
+    }
+    int count = ascii_get_table_count(ctx);
+    for (int i = 0; i < count; i++)
+        ascii_bake_glyphs(ctx, i);
+    trace_end("table reload", t);
+
+    // a reload nobody picked up yet is stale, it never got a renderer so it can go here
+    ascii_destroy(SDL_SetAtomicPointer(&watch_state.ready, ctx));
+    SDL_Log("Reloaded %d tables from %s in %.1f ms", count, watch_state.path, (SDL_GetTicksNS() - start) / 1e6);
+}
+
+static int SDLCALL watch_thread(void *data) {
+    (void)data;
+    trace_thread_name("table watch");
+    struct pollfd pfd = {.fd = watch_state.fd, .events = POLLIN};
+    bool changed = false;
+    while (!SDL_GetAtomicInt(&watch_state.quit)) {
+        int n = poll(&pfd, 1, changed ? SETTLE_MS : QUIT_POLL_MS);
+        if (n > 0) {
+            if (read_events()) changed = true;
+        } else if (n == 0 && changed && SDL_GetAtomicU32(&watch_state.font_size)) {
+            // a change before the first poll waits for the size the view uses
+            changed = false;
+            reload();
+        }
+    }
+    return 0;
+}
+
+static void set_font_size(float font_size) {
+    Uint32 bits;
+    SDL_memcpy(&bits, &font_size, sizeof(bits));
+    SDL_SetAtomicU32(&watch_state.font_size, bits);
+}
+
+bool table_watch_start(const char *table_file) {
+    SDL_SetAtomicU32(&watch_state.font_size, 0);
+    watch_state.path = SDL_strdup(table_file ? table_file : "ascii.tbl");
+    if (watch_state.path == NULL) return false;
+
+    // watch the directory, saving often replaces the file instead of writing it
+    char *slash = SDL_strrchr(watch_state.path, '/');
+    char *dir = slash ? SDL_strndup(watch_state.path, slash - watch_state.path + 1) : SDL_strdup(".");
+    watch_state.name = slash ? slash + 1 : watch_state.path;
+
+    watch_state.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch_state.fd < 0 || dir == NULL ||
+        inotify_add_watch(watch_state.fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        ERROR("Couldn't watch %s for changes", watch_state.path);
+        SDL_free(dir);
+        table_watch_stop();
+        return false;
+    }
+    SDL_free(dir);
+
+    SDL_SetAtomicInt(&watch_state.quit, 0);
+    watch_state.thread = SDL_CreateThread(watch_thread, "table watch", NULL);
+    if (watch_state.thread == NULL) {
+        ERROR("Failed to create table watch thread\n%s", SDL_GetError());
+        table_watch_stop();
+        return false;
+    }
+    watch_state.running = true;
+    return true;
+}
+
+AsciiContext *table_watch_poll(float font_size) {
+    if (!watch_state.running) return NULL;
+    set_font_size(font_size);
+    return SDL_SetAtomicPointer(&watch_state.ready, NULL);
+}
+
+void table_watch_stop() {
+    if (watch_state.thread) {
+        SDL_SetAtomicInt(&watch_state.quit, 1);
+        SDL_WaitThread(watch_state.thread, NULL);
+        watch_state.thread = NULL;
+    }
+    if (watch_state.fd >= 0) close(watch_state.fd);
+    watch_state.fd = -1;
+    ascii_destroy(SDL_SetAtomicPointer(&watch_state.ready, NULL));
+    SDL_free(watch_state.path);
+    watch_state.path = NULL;
+    watch_state.running = false;
+}
+
+#else
+
+// tables are only read at startup
+bool table_watch_start(const char *table_file) {
+    (void)table_file;
+    return false;
+}
+
+AsciiContext *table_watch_poll(float font_size) {
+    (void)font_size;
+    return NULL;
+}
+
+void table_watch_stop() {}
+
+#endif
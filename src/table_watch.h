@@ -0,0 +1,17 @@
+#ifndef TABLE_WATCH_H
+#define TABLE_WATCH_H
+#include "ascii.h"
+
+/* Reloads the table file when it changes on disk.
+   A thread waits on inotify and builds a complete ascii context with every
+   table's glyphs baked, the main thread picks it up between frames so a
+   reload never stalls drawing.
+*/
+bool table_watch_start(const char *table_file);
+/* newly loaded context or NULL, the caller owns it. tables are loaded at
+   the font_size of the last poll, none before the first
+*/
+AsciiContext *table_watch_poll(float font_size);
+void table_watch_stop();
+
+#endif
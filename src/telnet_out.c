@@ -0,0 +1,531 @@
+#include <SDL3/SDL.h>
+
+#include "stream.h"
+#include "telnet_out.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 64
+#define MAX_SIZES 16
+#define MAX_COLS 400
+#define MAX_ROWS 200
+#define CLIENT_MAX_BACKLOG (2 * 1024 * 1024)
+#define LINE_MAX 32
+
+// telnet protocol bytes
+#define IAC 255
+#define DONT 254
+#define DO 253
+#define WONT 252
+#define WILL 251
+#define SB 250
+#define SE 240
+#define NAWS 31
+
+#define SIZE_TAG(w, h) ((Uint32)(w) << 16 | (Uint32)(h))
+
+typedef enum {
+    PARSE_DATA,
+    PARSE_IAC,
+    PARSE_OPTION,
+    PARSE_SB,
+    PARSE_SB_IAC,
+} ParseState;
+
+typedef struct Client {
+    int fd;
+    int w, h;
+    ParseState parse;
+    Uint8 sb[8];
+    int sb_len;
+    char line[LINE_MAX];
+    int line_len;
+
+    StreamQueue queue;
+    struct Client *next;
+} Client;
+
+typedef struct {
+    int w, h;
+    int clients;
+} GridSize;
+
+// per size work buffers of the publishing thread
+typedef struct {
+    int w, h;
+    SDL_Surface *frame;
+    AsciiGrid grid;
+} SizeCache;
+
+struct {
+    bool running;
+    int default_w;
+    int default_h;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    SDL_Thread *thread;
+    SDL_AtomicInt quit;
+    SDL_AtomicInt client_count;
+
+    // shared between threads
+    SDL_Mutex *lock;
+    GridSize sizes[MAX_SIZES];
+    StreamMessage *pending[MAX_SIZES];
+    int pending_count;
+
+    // server thread only
+    Client *clients;
+
+    // publishing thread only
+    SizeCache cache[MAX_SIZES];
+    char *scratch;
+    size_t scratch_size;
+} telnet_state = {0};
+
+//---Client io (server thread)---
+
+static void client_update_events(Client *client) {
+    struct epoll_event ev = {
+        .events = EPOLLIN | (client->queue.count ? EPOLLOUT : 0),
+        .data.ptr = client,
+    };
+    epoll_ctl(telnet_state.epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
+}
+
+static void client_send(Client *client, const char *data, size_t len) {
+    StreamMessage *msg = stream_message_create(data, len, true);
+    if (msg == NULL) return;
+    stream_queue_push(&client->queue, msg, CLIENT_MAX_BACKLOG);
+    stream_message_unref(msg);
+}
+
+static void size_release(int w, int h) {
+    for (int i = 0; i < MAX_SIZES; i++) {
+        GridSize *size = &telnet_state.sizes[i];
+        if (size->clients && size->w == w && size->h == h) {
+            size->clients--;
+            return;
+        }
+    }
+}
+
+// returns false if there are too many distinct sizes
+static bool size_acquire(int w, int h) {
+    GridSize *free_size = NULL;
+    for (int i = 0; i < MAX_SIZES; i++) {
+        GridSize *size = &telnet_state.sizes[i];
+        if (size->clients && size->w == w && size->h == h) {
+            size->clients++;
+            return true;
+        }
+        if (!size->clients && !free_size) free_size = size;
+    }
+    if (!free_size) return false;
+    *free_size = (GridSize){w, h, 1};
+    return true;
+}
+
+static void client_set_size(Client *client, int cols, int rows) {
+    // keep the last line free so the terminal doesn't scroll
+    int w = SDL_clamp(cols, 1, MAX_COLS);
+    int h = SDL_clamp(rows - 1, 1, MAX_ROWS);
+    if (w == client->w && h == client->h) return;
+
+    SDL_LockMutex(telnet_state.lock);
+    if (client->w) size_release(client->w, client->h);
+    if (!size_acquire(w, h)) {
+        w = telnet_state.default_w;
+        h = telnet_state.default_h;
+        size_acquire(w, h);
+    }
+    SDL_UnlockMutex(telnet_state.lock);
+
+    client->w = w;
+    client->h = h;
+    stream_queue_clear(&client->queue, true);
+    client_send(client, "\x1b[0m\x1b[2J", 8);
+}
+
+// returns false if the client should be closed
+static bool client_parse(Client *client, Uint8 *data, int len) {
+    for (int i = 0; i < len; i++) {
+        Uint8 c = data[i];
+        switch (client->parse) {
+            case PARSE_DATA:
+                if (c == IAC) {
+                    client->parse = PARSE_IAC;
+                } else if (c == '\n') {
+                    client->line[client->line_len] = '\0';
+                    client->line_len = 0;
+                    int cols, rows;
+                    if (client->line[0] == 'q') return false;
+                    if (SDL_sscanf(client->line, "%dx%d", &cols, &rows) == 2) {
+                        client_set_size(client, cols, rows + 1);
+                    }
+                } else if (c >= ' ' && client->line_len < LINE_MAX - 1) {
+                    client->line[client->line_len++] = c;
+                }
+            break;
+            case PARSE_IAC:
+                if (c == SB) {
+                    client->parse = PARSE_SB;
+                    client->sb_len = 0;
+                } else if (c >= WILL && c <= DONT) {
+                    client->parse = PARSE_OPTION;
+                } else {
+                    client->parse = PARSE_DATA;
+                }
+            break;
+            case PARSE_OPTION:
+                client->parse = PARSE_DATA;
+            break;
+            case PARSE_SB:
+                if (c == IAC) client->parse = PARSE_SB_IAC;
+                else if (client->sb_len < (int)sizeof(client->sb)) client->sb[client->sb_len++] = c;
+            break;
+            case PARSE_SB_IAC:
+                if (c == IAC) {
+                    if (client->sb_len < (int)sizeof(client->sb)) client->sb[client->sb_len++] = c;
+                    client->parse = PARSE_SB;
+                    break;
+                }
+                client->parse = PARSE_DATA;
+                // IAC SB NAWS <w16> <h16> IAC SE
+                if (c == SE && client->sb_len == 5 && client->sb[0] == NAWS) {
+                    int cols = client->sb[1] << 8 | client->sb[2];
+                    int rows = client->sb[3] << 8 | client->sb[4];
+                    if (cols > 0 && rows > 0) client_set_size(client, cols, rows);
+                }
+            break;
+        }
+    }
+    return true;
+}
+
+static void client_close(Client *client) {
+    Client **it = &telnet_state.clients;
+    while (*it != client) it = &(*it)->next;
+    *it = client->next;
+
+    SDL_LockMutex(telnet_state.lock);
+    size_release(client->w, client->h);
+    SDL_UnlockMutex(telnet_state.lock);
+    SDL_AddAtomicInt(&telnet_state.client_count, -1);
+
+    // restore the terminal, best effort
+    send(client->fd, "\x1b[0m\x1b[?25h\r\n", 12, MSG_NOSIGNAL | MSG_DONTWAIT);
+    stream_queue_clear(&client->queue, false);
+    close(client->fd);
+    SDL_free(client);
+}
+
+static void accept_clients() {
+    while (true) {
+        int fd = accept(telnet_state.listen_fd, NULL, NULL);
+        if (fd < 0) return;
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        Client *client = SDL_calloc(1, sizeof(Client));
+        if (client == NULL) {
+            close(fd);
+            return;
+        }
+        client->fd = fd;
+        client->next = telnet_state.clients;
+        telnet_state.clients = client;
+        SDL_AddAtomicInt(&telnet_state.client_count, 1);
+
+        // ask telnet clients for their window size, plain nc users can type WxH
+        static const char greeting[] = {IAC, DO, NAWS, '\x1b', '[', '?', '2', '5', 'l'};
+        client_set_size(client, telnet_state.default_w, telnet_state.default_h + 1);
+        client_send(client, greeting, sizeof(greeting));
+
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT, .data.ptr = client};
+        epoll_ctl(telnet_state.epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+static void fan_out() {
+    Uint64 count;
+    read(telnet_state.wake_fd, &count, sizeof(count));
+
+    StreamMessage *pending[MAX_SIZES];
+    SDL_LockMutex(telnet_state.lock);
+    int pending_count = telnet_state.pending_count;
+    SDL_memcpy(pending, telnet_state.pending, pending_count * sizeof(StreamMessage *));
+    telnet_state.pending_count = 0;
+    SDL_UnlockMutex(telnet_state.lock);
+
+    for (int i = 0; i < pending_count; i++) {
+        for (Client *client = telnet_state.clients; client; client = client->next) {
+            if (pending[i]->tag != SIZE_TAG(client->w, client->h)) continue;
+            // every frame is a full redraw so only the newest one is worth sending
+            stream_queue_clear(&client->queue, true);
+            stream_queue_push(&client->queue, pending[i], CLIENT_MAX_BACKLOG);
+            client_update_events(client);
+        }
+        stream_message_unref(pending[i]);
+    }
+}
+
+static int server_thread(void *data) {
+    (void)data;
+    struct epoll_event events[MAX_EVENTS];
+    Uint8 buf[512];
+    while (!SDL_GetAtomicInt(&telnet_state.quit)) {
+        int n = epoll_wait(telnet_state.epoll_fd, events, MAX_EVENTS, 500);
+        for (int i = 0; i < n; i++) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == &telnet_state.listen_fd) {
+                accept_clients();
+                continue;
+            }
+            if (ptr == &telnet_state.wake_fd) {
+                fan_out();
+                continue;
+            }
+
+            Client *client = ptr;
+            bool keep = !(events[i].events & (EPOLLERR | EPOLLHUP));
+            if (keep && (events[i].events & EPOLLIN)) {
+                ssize_t len = recv(client->fd, buf, sizeof(buf), 0);
+                if (len == 0) keep = false;
+                else if (len > 0) keep = client_parse(client, buf, len);
+                else keep = errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            if (keep) keep = stream_queue_flush(&client->queue, client->fd);
+            if (keep) client_update_events(client);
+            else client_close(client);
+        }
+    }
+
+    while (telnet_state.clients) client_close(telnet_state.clients);
+    return 0;
+}
+
+// sockets of a failed start, the ones not created yet are -1
+static void close_fds() {
+    close(telnet_state.listen_fd);
+    if (telnet_state.epoll_fd >= 0) close(telnet_state.epoll_fd);
+    if (telnet_state.wake_fd >= 0) close(telnet_state.wake_fd);
+}
+
+bool telnet_out_start(const char *address, int default_w, int default_h) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    const char *colon = SDL_strrchr(address, ':');
+    int port = SDL_atoi(colon ? colon + 1 : address);
+    if (colon) {
+        char host[64];
+        SDL_strlcpy(host, address, SDL_min(sizeof(host), (size_t)(colon - address + 1)));
+        if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+            ERROR("Invalid telnet address %s", address);
+            return false;
+        }
+    }
+    if (port <= 0 || port > 65535) {
+        ERROR("Invalid telnet port %s", address);
+        return false;
+    }
+    addr.sin_port = htons(port);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ERROR("Couldn't create telnet socket");
+        return false;
+    }
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        ERROR("Couldn't listen on %s", address);
+        close(fd);
+        return false;
+    }
+
+    telnet_state.default_w = SDL_clamp(default_w, 1, MAX_COLS);
+    telnet_state.default_h = SDL_clamp(default_h - 1, 1, MAX_ROWS);
+    telnet_state.listen_fd = fd;
+    telnet_state.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    telnet_state.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &telnet_state.listen_fd};
+    struct epoll_event wake = {.events = EPOLLIN, .data.ptr = &telnet_state.wake_fd};
+    if (telnet_state.epoll_fd < 0 || telnet_state.wake_fd < 0 ||
+        epoll_ctl(telnet_state.epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0 ||
+        epoll_ctl(telnet_state.epoll_fd, EPOLL_CTL_ADD, telnet_state.wake_fd, &wake) < 0) {
+        ERROR("Couldn't set up telnet polling");
+        close_fds();
+        return false;
+    }
+
+    telnet_state.lock = SDL_CreateMutex();
+    if (telnet_state.lock == NULL) {
+        ERROR("Couldn't create telnet lock\n%s", SDL_GetError());
+        close_fds();
+        return false;
+    }
+    SDL_SetAtomicInt(&telnet_state.quit, 0);
+    telnet_state.thread = SDL_CreateThread(server_thread, "telnet", NULL);
+    if (telnet_state.thread == NULL) {
+        ERROR("Couldn't create telnet thread\n%s", SDL_GetError());
+        SDL_DestroyMutex(telnet_state.lock);
+        close_fds();
+        return false;
+    }
+    telnet_state.running = true;
+    char host[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr.sin_addr, host, sizeof(host));
+    SDL_Log("Serving ANSI ascii on %s:%d", host, port);
+    return true;
+}
+
+//---Encoding (publishing thread)---
+
+static StreamMessage *encode_ansi(AsciiContext *ctx, AsciiGrid *grid) {
+    size_t max_size = (size_t)grid->w * grid->h * 42 + grid->h * 8 + 16;
+    if (max_size > telnet_state.scratch_size) {
+        char *scratch = SDL_realloc(telnet_state.scratch, max_size);
+        if (scratch == NULL) return NULL;
+        telnet_state.scratch = scratch;
+        telnet_state.scratch_size = max_size;
+    }
+
+    int table_len;
+    const Uint32 *table = ascii_get_table(ctx, grid->table_index, &table_len);
+    char *p = telnet_state.scratch;
+    p += SDL_snprintf(p, 8, "\x1b[H");
+    for (int y = 0; y < grid->h; y++) {
+        AsciiCell *row = grid->cells + y * grid->w;
+        // only emit a color when it changes, the default background stays the terminals own
+        int prev = -1, prev_bg = -1;
+        for (int x = 0; x < grid->w; x++) {
+            AsciiCell cell = row[x];
+            int color = cell.r << 16 | cell.g << 8 | cell.b;
+            if (color != prev) {
+                p += SDL_snprintf(p, 20, "\x1b[38;2;%d;%d;%dm", cell.r, cell.g, cell.b);
+                prev = color;
+            }
+            int bg = cell.bg_r << 16 | cell.bg_g << 8 | cell.bg_b;
+            if (bg == (ASCII_BACKGROUND << 16 | ASCII_BACKGROUND << 8 | ASCII_BACKGROUND)) bg = -1;
+            if (bg != prev_bg) {
+                if (bg < 0) p += SDL_snprintf(p, 6, "\x1b[49m");
+                else p += SDL_snprintf(p, 20, "\x1b[48;2;%d;%d;%dm", cell.bg_r, cell.bg_g, cell.bg_b);
+                prev_bg = bg;
+            }
+            p = SDL_UCS4ToUTF8(table[cell.glyph], p);
+        }
+        // a colored background would bleed into the line break
+        if (prev_bg >= 0) p += SDL_snprintf(p, 6, "\x1b[49m");
+        if (y < grid->h - 1) {
+            *p++ = '\r';
+            *p++ = '\n';
+        }
+    }
+    StreamMessage *msg = stream_message_create(telnet_state.scratch, p - telnet_state.scratch, true);
+    if (msg) msg->tag = SIZE_TAG(grid->w, grid->h);
+    return msg;
+}
+
+void telnet_out_publish(AsciiContext *ctx, SDL_Surface *frame, const AsciiView *view, AsciiMode mode, int table_index) {
+    if (!telnet_state.running || SDL_GetAtomicInt(&telnet_state.client_count) == 0) return;
+
+    GridSize sizes[MAX_SIZES];
+    SDL_LockMutex(telnet_state.lock);
+    SDL_memcpy(sizes, telnet_state.sizes, sizeof(sizes));
+    SDL_UnlockMutex(telnet_state.lock);
+
+    int sx, sy;
+    ascii_mode_scale(mode, &sx, &sy);
+    StreamMessage *messages[MAX_SIZES];
+    int message_count = 0;
+    for (int i = 0; i < MAX_SIZES; i++) {
+        GridSize size = sizes[i];
+        if (size.clients == 0) continue;
+
+        SizeCache *cache = &telnet_state.cache[i];
+        if (cache->w != size.w || cache->h != size.h || cache->frame->w != size.w * sx || cache->frame->h != size.h * sy) {
+            SDL_DestroySurface(cache->frame);
+            cache->frame = SDL_CreateSurface(size.w * sx, size.h * sy, SDL_PIXELFORMAT_RGB24);
+            if (cache->frame == NULL || !ascii_grid_resize(&cache->grid, size.w, size.h)) {
+                cache->w = 0;
+                continue;
+            }
+            cache->w = size.w;
+            cache->h = size.h;
+        }
+
+        ascii_sample(frame, view, cache->frame);
+        ascii_compute_mode(ctx, mode, &cache->grid, cache->frame, table_index);
+        StreamMessage *msg = encode_ansi(ctx, &cache->grid);
+        if (msg) messages[message_count++] = msg;
+    }
+    if (message_count == 0) return;
+
+    SDL_LockMutex(telnet_state.lock);
+    // frames the server thread hasn't picked up yet are stale now
+    for (int i = 0; i < telnet_state.pending_count; i++) stream_message_unref(telnet_state.pending[i]);
+    SDL_memcpy(telnet_state.pending, messages, message_count * sizeof(StreamMessage *));
+    telnet_state.pending_count = message_count;
+    SDL_UnlockMutex(telnet_state.lock);
+
+    Uint64 one = 1;
+    write(telnet_state.wake_fd, &one, sizeof(one));
+}
+
+void telnet_out_stop() {
+    if (!telnet_state.running) return;
+    SDL_SetAtomicInt(&telnet_state.quit, 1);
+    Uint64 one = 1;
+    write(telnet_state.wake_fd, &one, sizeof(one));
+    SDL_WaitThread(telnet_state.thread, NULL);
+
+    for (int i = 0; i < telnet_state.pending_count; i++) stream_message_unref(telnet_state.pending[i]);
+    telnet_state.pending_count = 0;
+    for (int i = 0; i < MAX_SIZES; i++) {
+        SDL_DestroySurface(telnet_state.cache[i].frame);
+        ascii_grid_free(&telnet_state.cache[i].grid);
+        telnet_state.cache[i] = (SizeCache){0};
+    }
+    close(telnet_state.listen_fd);
+    close(telnet_state.wake_fd);
+    close(telnet_state.epoll_fd);
+    SDL_DestroyMutex(telnet_state.lock);
+    SDL_free(telnet_state.scratch);
+    telnet_state.scratch = NULL;
+    telnet_state.scratch_size = 0;
+    telnet_state.running = false;
+}
+
+#else
+
+bool telnet_out_start(const char *address, int default_w, int default_h) {
+    (void)address;
+    (void)default_w;
+    (void)default_h;
+    ERROR("The telnet server is not supported on this platform");
+    return false;
+}
+
+void telnet_out_publish(AsciiContext *ctx, SDL_Surface *frame, const AsciiView *view, AsciiMode mode, int table_index) {
+    (void)ctx;
+    (void)frame;
+    (void)view;
+    (void)mode;
+    (void)table_index;
+}
+
+void telnet_out_stop() {}
+
+#endif
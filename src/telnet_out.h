@@ -0,0 +1,16 @@
+#ifndef TELNET_OUT_H
+#define TELNET_OUT_H
+#include "ascii.h"
+
+/* TCP server streaming ANSI ascii to terminals, e.g. nc host <port>.
+   each client is sized from telnet NAWS, by typing WxH<enter> or the
+   default size. a grid is computed once per distinct size and shared,
+   slow clients skip frames instead of queueing them. address is
+   [addr:]port, 127.0.0.1 unless addr is given
+*/
+bool telnet_out_start(const char *address, int default_w, int default_h);
+// frame can be in any format, the view of it is scaled to every client size
+void telnet_out_publish(AsciiContext *ctx, SDL_Surface *frame, const AsciiView *view, AsciiMode mode, int table_index);
+void telnet_out_stop();
+
+#endif
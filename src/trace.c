@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+// events kept per thread, a couple of minutes of the main loop
+#define RING_SIZE (1 << 16)
+
+typedef struct {
+    const char *name;
+    Uint64 begin;
+    Uint64 end;
+} TraceEvent;
+
+// only its own thread writes a ring, head counts every event it ever recorded
+typedef struct TraceRing {
+    struct TraceRing *next;
+    SDL_ThreadID thread;
+    const char *thread_name;
+    SDL_AtomicU32 head;
+    TraceEvent events[RING_SIZE];
+} TraceRing;
+
+static struct {
+    SDL_AtomicInt enabled;
+    char *path;
+    void *rings; // TraceRing list, only pushed to until trace_stop
+} trace_state = {0};
+
+static _Thread_local TraceRing *thread_ring;
+
+static TraceRing *get_ring() {
+    if (thread_ring) return thread_ring;
+    TraceRing *ring = calloc(1, sizeof(TraceRing));
+    if (ring == NULL) return NULL;
+    ring->thread = SDL_GetCurrentThreadID();
+    do {
+        ring->next = SDL_GetAtomicPointer(&trace_state.rings);
+    } while (!SDL_CompareAndSwapAtomicPointer(&trace_state.rings, ring->next, ring));
+    thread_ring = ring;
+    return ring;
+}
+
+bool trace_start(const char *path) {
+    trace_state.path = SDL_strdup(path);
+    if (trace_state.path == NULL) return false;
+    SDL_SetAtomicInt(&trace_state.enabled, 1);
+    SDL_Log("Tracing to %s", path);
+    return true;
+}
+
+Uint64 trace_begin() {
+    if (!SDL_GetAtomicInt(&trace_state.enabled)) return 0;
+    return SDL_max(SDL_GetTicksNS(), 1);
+}
+
+void trace_end(const char *name, Uint64 begin) {
+    if (begin == 0) return;
+    Uint64 end = SDL_GetTicksNS();
+    TraceRing *ring = get_ring();
+    if (ring == NULL) return;
+    Uint32 head = SDL_GetAtomicU32(&ring->head);
+    ring->events[head % RING_SIZE] = (TraceEvent){name, begin, end};
+    SDL_SetAtomicU32(&ring->head, head + 1);
+}
+
+void trace_thread_name(const char *name) {
+    if (!SDL_GetAtomicInt(&trace_state.enabled)) return;
+    TraceRing *ring = get_ring();
+    if (ring) ring->thread_name = name;
+}
+
+bool trace_write() {
+    if (trace_state.path == NULL) return false;
+    FILE *out = fopen(trace_state.path, "w");
+    if (out == NULL) {
+        ERROR("Couldn't open %s", trace_state.path);
+        return false;
+    }
+
+    int count = 0;
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (TraceRing *ring = SDL_GetAtomicPointer(&trace_state.rings); ring; ring = ring->next) {
+        unsigned long long tid = ring->thread;
+        if (ring->thread_name) {
+            fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %llu, "
+                         "\"args\": {\"name\": \"%s\"}}", count++ ? ",\n" : "", tid, ring->thread_name);
+        }
+        Uint32 head = SDL_GetAtomicU32(&ring->head);
+        for (Uint32 i = head - SDL_min(head, RING_SIZE); i != head; i++) {
+            TraceEvent e = ring->events[i % RING_SIZE];
+            // the thread may have lapped the slot while it was copied
+            SDL_MemoryBarrierAcquire();
+            if (SDL_GetAtomicU32(&ring->head) - i >= RING_SIZE) continue;
+            fprintf(out, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %llu, \"ts\": %.3f, \"dur\": %.3f}",
+                    count++ ? ",\n" : "", e.name, tid, e.begin / 1e3, (e.end - e.begin) / 1e3);
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    bool ok = fclose(out) == 0;
+    if (ok) SDL_Log("Wrote %d trace events to %s", count, trace_state.path);
+    else ERROR("Couldn't write %s", trace_state.path);
+    return ok;
+}
+
+void trace_stop() {
+    if (trace_state.path == NULL) return;
+    trace_write();
+    SDL_SetAtomicInt(&trace_state.enabled, 0);
+    TraceRing *ring = SDL_SetAtomicPointer(&trace_state.rings, NULL);
+    while (ring) {
+        TraceRing *next = ring->next;
+        free(ring);
+        ring = next;
+    }
+    thread_ring = NULL;
+    SDL_free(trace_state.path);
+    trace_state.path = NULL;
+}
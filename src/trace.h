@@ -0,0 +1,26 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <SDL3/SDL.h>
+
+/* Timeline of pipeline stages as Chrome trace events, open the file in
+   chrome://tracing or ui.perfetto.dev. Every thread records into its own
+   ring so markers never lock, the newest events of each ring are written.
+   Markers cost one atomic load while tracing is off.
+
+   Uint64 t = trace_begin();
+   ...
+   trace_end("stage", t);
+*/
+bool trace_start(const char *path);
+// 0 while tracing is off
+Uint64 trace_begin();
+// name must outlive the trace, use string literals
+void trace_end(const char *name, Uint64 begin);
+// label the calling thread in the trace
+void trace_thread_name(const char *name);
+// write everything recorded so far, can be called while other threads trace
+bool trace_write();
+// writes and frees the rings, no thread may trace anymore
+void trace_stop();
+
+#endif
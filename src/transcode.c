@@ -0,0 +1,508 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL.h>
+
+#include "ascii.h"
+#include "trace.h"
+#include "transcode.h"
+
+#define ERROR(fmt, ...) SDL_Log("ERROR: " fmt, ##__VA_ARGS__)
+
+#define DEFAULT_FONT_SIZE 8
+#define MAX_HEADER_LEN 1024
+// frames in flight per worker thread
+#define SLOTS_PER_THREAD 2
+
+typedef enum {
+    FORMAT_RAW,  // packed RGB24
+    FORMAT_420,  // planar Y4M
+    FORMAT_444,
+    FORMAT_MONO,
+} InputFormat;
+
+typedef struct {
+    FILE *file;
+    InputFormat format;
+    bool full_range;
+    int w, h;
+    int fps_num, fps_den;
+    size_t frame_size;
+} VideoIn;
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_QUEUED,
+    SLOT_BUSY,
+    SLOT_DONE,
+} SlotState;
+
+// one frame in flight, owns all buffers needed to process it
+typedef struct {
+    SlotState state;
+    Uint8 *in;
+    SDL_Surface *frame; // input sampled for the mode
+    AsciiGrid grid;
+    SDL_Surface *out;
+    Uint8 *yuv;
+} Slot;
+
+struct {
+    AsciiContext *ascii;
+    VideoIn video;
+    AsciiMode mode;
+    int table_index;
+    int cols, rows;
+    int out_w, out_h;
+    size_t yuv_size;
+    int *x_map;
+    int *y_map;
+
+    Slot *slots;
+    int slot_count;
+    Uint64 next_dispatch;
+    bool quit;
+    SDL_Mutex *lock;
+    SDL_Condition *work_cond;
+    SDL_Condition *done_cond;
+} tc_state = {0};
+
+static bool read_line(FILE *file, char *line, int max) {
+    int len = 0;
+    int c;
+    while ((c = fgetc(file)) != EOF && c != '\n') {
+        if (len < max - 1) line[len++] = c;
+    }
+    line[len] = '\0';
+    return c == '\n';
+}
+
+static bool parse_y4m_header(VideoIn *video) {
+    char header[MAX_HEADER_LEN];
+    if (!read_line(video->file, header, MAX_HEADER_LEN) || strncmp(header, "YUV4MPEG2 ", 10) != 0) {
+        ERROR("Input is not a Y4M stream");
+        return false;
+    }
+
+    video->format = FORMAT_420;
+    video->fps_num = 30;
+    video->fps_den = 1;
+    char *save = NULL;
+    for (char *tok = SDL_strtok_r(header + 10, " ", &save); tok; tok = SDL_strtok_r(NULL, " ", &save)) {
+        switch (tok[0]) {
+            case 'W': video->w = SDL_atoi(tok + 1);
+            break;
+            case 'H': video->h = SDL_atoi(tok + 1);
+            break;
+            case 'F': sscanf(tok + 1, "%d:%d", &video->fps_num, &video->fps_den);
+            break;
+            case 'C': {
+                if (strncmp(tok + 1, "420", 3) == 0) video->format = FORMAT_420;
+                else if (strcmp(tok + 1, "444") == 0) video->format = FORMAT_444;
+                else if (strcmp(tok + 1, "mono") == 0) video->format = FORMAT_MONO;
+                else {
+                    ERROR("Unsupported Y4M colorspace %s", tok + 1);
+                    return false;
+                }
+            }
+            break;
+            case 'X':
+                if (strcmp(tok, "XCOLORRANGE=FULL") == 0) video->full_range = true;
+            break;
+        }
+    }
+
+    size_t luma = (size_t)video->w * video->h;
+    size_t chroma = (size_t)((video->w + 1) / 2) * ((video->h + 1) / 2);
+    switch (video->format) {
+        case FORMAT_420: video->frame_size = luma + 2 * chroma;
+        break;
+        case FORMAT_444: video->frame_size = 3 * luma;
+        break;
+        default: video->frame_size = luma;
+        break;
+    }
+    return true;
+}
+
+static bool read_frame(VideoIn *video, Uint8 *dst) {
+    if (video->format != FORMAT_RAW) {
+        char line[MAX_HEADER_LEN];
+        if (!read_line(video->file, line, MAX_HEADER_LEN)) return false;
+        if (strncmp(line, "FRAME", 5) != 0) {
+            ERROR("Bad Y4M frame header");
+            return false;
+        }
+    }
+    return fread(dst, 1, video->frame_size, video->file) == video->frame_size;
+}
+
+static Uint8 clamp_u8(float v) {
+    return v < 0.0f ? 0 : v > 255.0f ? 255 : (Uint8)v;
+}
+
+// nearest sample the input at the frame size of the mode, only touches those pixels
+static void sample_frame(Uint8 *in, SDL_Surface *frame) {
+    VideoIn *video = &tc_state.video;
+    int w = video->w;
+    int cw = (w + 1) / 2;
+    Uint8 *y_plane = in;
+    Uint8 *u_plane = in + (size_t)w * video->h;
+    size_t chroma_size = video->format == FORMAT_444 ? (size_t)w * video->h
+                                                     : (size_t)cw * ((video->h + 1) / 2);
+    Uint8 *v_plane = u_plane + chroma_size;
+
+    for (int y = 0; y < frame->h; y++) {
+        int sy = tc_state.y_map[y];
+        Uint8 *dst = (Uint8 *)frame->pixels + y * frame->pitch;
+        for (int x = 0; x < frame->w; x++, dst += 3) {
+            int sx = tc_state.x_map[x];
+            if (video->format == FORMAT_RAW) {
+                Uint8 *src = in + ((size_t)sy * w + sx) * 3;
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+                continue;
+            }
+
+            float luma = y_plane[(size_t)sy * w + sx];
+            float u = 0.0f, v = 0.0f;
+            if (video->format == FORMAT_420) {
+                size_t i = (size_t)(sy / 2) * cw + sx / 2;
+                u = u_plane[i] - 128.0f;
+                v = v_plane[i] - 128.0f;
+            } else if (video->format == FORMAT_444) {
+                size_t i = (size_t)sy * w + sx;
+                u = u_plane[i] - 128.0f;
+                v = v_plane[i] - 128.0f;
+            }
+
+            // BT.601
+            if (video->full_range) {
+                dst[0] = clamp_u8(luma + 1.402f*v);
+                dst[1] = clamp_u8(luma - 0.344f*u - 0.714f*v);
+                dst[2] = clamp_u8(luma + 1.772f*u);
+            } else {
+                luma = 1.164f * (luma - 16.0f);
+                dst[0] = clamp_u8(luma + 1.596f*v);
+                dst[1] = clamp_u8(luma - 0.392f*u - 0.813f*v);
+                dst[2] = clamp_u8(luma + 2.017f*u);
+            }
+        }
+    }
+}
+
+static void process_slot(Slot *slot) {
+    Uint64 t = trace_begin();
+    sample_frame(slot->in, slot->frame);
+    ascii_compute_mode(tc_state.ascii, tc_state.mode, &slot->grid, slot->frame, tc_state.table_index);
+    ascii_raster(tc_state.ascii, slot->out, &slot->grid);
+    SDL_ConvertPixelsAndColorspace(slot->out->w, slot->out->h,
+                                   SDL_PIXELFORMAT_RGB24, SDL_COLORSPACE_SRGB, 0,
+                                   slot->out->pixels, slot->out->pitch,
+                                   SDL_PIXELFORMAT_IYUV, SDL_COLORSPACE_BT601_LIMITED, 0,
+                                   slot->yuv, slot->out->w);
+    trace_end("transcode frame", t);
+}
+
+static int worker(void *data) {
+    (void)data;
+    trace_thread_name("transcode");
+    SDL_LockMutex(tc_state.lock);
+    while (true) {
+        // frames are queued in order so the next one to dispatch is always at a known slot
+        Slot *slot = &tc_state.slots[tc_state.next_dispatch % tc_state.slot_count];
+        if (slot->state != SLOT_QUEUED) {
+            if (tc_state.quit) break;
+            SDL_WaitCondition(tc_state.work_cond, tc_state.lock);
+            continue;
+        }
+        slot->state = SLOT_BUSY;
+        tc_state.next_dispatch++;
+        SDL_UnlockMutex(tc_state.lock);
+
+        process_slot(slot);
+
+        SDL_LockMutex(tc_state.lock);
+        slot->state = SLOT_DONE;
+        SDL_SignalCondition(tc_state.done_cond);
+    }
+    SDL_UnlockMutex(tc_state.lock);
+    return 0;
+}
+
+static bool write_slot(FILE *out, Slot *slot) {
+    return fputs("FRAME\n", out) >= 0 &&
+           fwrite(slot->yuv, 1, tc_state.yuv_size, out) == tc_state.yuv_size;
+}
+
+static bool parse_size(char *str, int *w, int *h) {
+    return sscanf(str, "%dx%d", w, h) == 2 && *w > 0 && *h > 0;
+}
+
+static void print_usage() {
+    SDL_Log("Usage: j-ascii transcode [options] <in.y4m|-> <out.y4m|->");
+    SDL_Log("  -f <.tbl file>   ascii table file");
+    SDL_Log("  -t <index>       table index, 0 is the default table");
+    SDL_Log("  -m <mode>        table, braille or half (default table)");
+    SDL_Log("  -c <columns>     grid width in cells (default %d)", DEFAULT_RES);
+    SDL_Log("  -s <size>        font size in pixels, also the cell size (default %d)", DEFAULT_FONT_SIZE);
+    SDL_Log("  -j <threads>     worker threads (default all cores)");
+    SDL_Log("  --raw <WxH>      input is raw RGB24 frames instead of Y4M");
+    SDL_Log("  --fps <n>        frame rate for raw input (default 30)");
+    SDL_Log("  --trace <file>   write a Chrome trace of the workers");
+}
+
+int transcode_main(int argc, char *argv[]) {
+    char *table_file = NULL;
+    char *in_path = NULL;
+    char *out_path = NULL;
+    int font_size = DEFAULT_FONT_SIZE;
+    int threads = SDL_GetNumLogicalCPUCores();
+    VideoIn *video = &tc_state.video;
+    video->fps_num = 30;
+    video->fps_den = 1;
+    tc_state.cols = DEFAULT_RES;
+    bool raw = false;
+
+    // args
+    for (int i = 0; i < argc; i++) {
+        char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_usage();
+            return 0;
+        } else if (strcmp(arg, "-f") == 0 && has_value) {
+            table_file = argv[++i];
+        } else if (strcmp(arg, "-t") == 0 && has_value) {
+            tc_state.table_index = SDL_atoi(argv[++i]);
+        } else if (strcmp(arg, "-m") == 0 && has_value) {
+            char *name = argv[++i];
+            tc_state.mode = ASCII_MODE_COUNT;
+            for (int m = 0; m < ASCII_MODE_COUNT; m++) {
+                if (strcmp(name, ascii_mode_name(m)) == 0) tc_state.mode = m;
+            }
+            if (tc_state.mode == ASCII_MODE_COUNT) {
+                ERROR("Invalid mode %s", name);
+                return 1;
+            }
+        } else if (strcmp(arg, "-c") == 0 && has_value) {
+            tc_state.cols = SDL_atoi(argv[++i]);
+        } else if (strcmp(arg, "-s") == 0 && has_value) {
+            font_size = SDL_atoi(argv[++i]);
+        } else if (strcmp(arg, "-j") == 0 && has_value) {
+            threads = SDL_atoi(argv[++i]);
+        } else if (strcmp(arg, "--raw") == 0 && has_value) {
+            raw = true;
+            if (!parse_size(argv[++i], &video->w, &video->h)) {
+                ERROR("Invalid raw size %s", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--fps") == 0 && has_value) {
+            video->fps_num = SDL_atoi(argv[++i]);
+        } else if (strcmp(arg, "--trace") == 0 && has_value) {
+            if (!trace_start(argv[++i])) return 1;
+            trace_thread_name("io");
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            ERROR("Invalid argument %s", arg);
+            return 1;
+        } else if (in_path == NULL) {
+            in_path = arg;
+        } else if (out_path == NULL) {
+            out_path = arg;
+        } else {
+            ERROR("Invalid argument %s", arg);
+            return 1;
+        }
+    }
+    if (in_path == NULL || out_path == NULL) {
+        print_usage();
+        return 1;
+    }
+    if (tc_state.cols < 1 || font_size < 1 || threads < 1 || video->fps_num < 1) {
+        ERROR("Invalid transcode options");
+        return 1;
+    }
+
+    // open input and output
+    video->file = strcmp(in_path, "-") == 0 ? stdin : fopen(in_path, "rb");
+    if (video->file == NULL) {
+        ERROR("Could not open input %s", in_path);
+        return 1;
+    }
+    if (raw) {
+        video->format = FORMAT_RAW;
+        video->frame_size = (size_t)video->w * video->h * 3;
+    } else if (!parse_y4m_header(video)) {
+        return 1;
+    }
+    if (video->w <= 0 || video->h <= 0) {
+        ERROR("Invalid input size %dx%d", video->w, video->h);
+        return 1;
+    }
+    FILE *out = strcmp(out_path, "-") == 0 ? stdout : fopen(out_path, "wb");
+    if (out == NULL) {
+        ERROR("Could not open output %s", out_path);
+        return 1;
+    }
+
+    // grid and output size, output must be even for 4:2:0
+    int cols = tc_state.cols;
+    int rows = SDL_max(1, cols * video->h / video->w);
+    tc_state.rows = rows;
+    tc_state.out_w = (cols * font_size + 1) & ~1;
+    tc_state.out_h = (rows * font_size + 1) & ~1;
+    tc_state.yuv_size = (size_t)tc_state.out_w * tc_state.out_h * 3 / 2;
+    int sx, sy;
+    ascii_mode_scale(tc_state.mode, &sx, &sy);
+    int frame_w = cols * sx, frame_h = rows * sy;
+    tc_state.x_map = malloc(frame_w * sizeof(int));
+    tc_state.y_map = malloc(frame_h * sizeof(int));
+    if (tc_state.x_map == NULL || tc_state.y_map == NULL) {
+        ERROR("Out of memory for a %dx%d sampling map", frame_w, frame_h);
+        return 1;
+    }
+    for (int x = 0; x < frame_w; x++) tc_state.x_map[x] = (x * video->w + video->w / 2) / frame_w;
+    for (int y = 0; y < frame_h; y++) tc_state.y_map[y] = (y * video->h + video->h / 2) / frame_h;
+
+    tc_state.ascii = ascii_create(NULL, font_size, table_file);
+    if (tc_state.ascii == NULL) return 1;
+    if (tc_state.table_index < 0 || tc_state.table_index >= ascii_get_table_count(tc_state.ascii)) {
+        ERROR("Invalid table index %d", tc_state.table_index);
+        return 1;
+    }
+    int table = ascii_mode_table(tc_state.ascii, tc_state.mode, tc_state.table_index);
+    if (!ascii_bake_glyphs(tc_state.ascii, table)) return 1;
+
+    // slots
+    tc_state.slot_count = threads * SLOTS_PER_THREAD;
+    tc_state.slots = calloc(tc_state.slot_count, sizeof(Slot));
+    if (tc_state.slots == NULL) {
+        ERROR("Out of memory for %d frame slots", tc_state.slot_count);
+        return 1;
+    }
+    for (int i = 0; i < tc_state.slot_count; i++) {
+        Slot *slot = &tc_state.slots[i];
+        slot->in = malloc(video->frame_size);
+        slot->frame = SDL_CreateSurface(frame_w, frame_h, SDL_PIXELFORMAT_RGB24);
+        slot->out = SDL_CreateSurface(tc_state.out_w, tc_state.out_h, SDL_PIXELFORMAT_RGB24);
+        slot->yuv = malloc(tc_state.yuv_size);
+        if (!slot->in || !slot->frame || !slot->out || !slot->yuv ||
+            !ascii_grid_resize(&slot->grid, cols, rows)) {
+            ERROR("Out of memory for %d frame slots", tc_state.slot_count);
+            return 1;
+        }
+    }
+
+    tc_state.lock = SDL_CreateMutex();
+    tc_state.work_cond = SDL_CreateCondition();
+    tc_state.done_cond = SDL_CreateCondition();
+    if (!tc_state.lock || !tc_state.work_cond || !tc_state.done_cond) {
+        ERROR("Couldn't create the worker locks\n%s", SDL_GetError());
+        return 1;
+    }
+    SDL_Thread **workers = malloc(threads * sizeof(SDL_Thread *));
+    if (workers == NULL) {
+        ERROR("Out of memory for %d workers", threads);
+        return 1;
+    }
+    // the reading loop only waits on workers that actually run
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        workers[started] = SDL_CreateThread(worker, "transcode", NULL);
+        if (workers[started]) started++;
+    }
+    if (started == 0) {
+        ERROR("Couldn't start any worker thread\n%s", SDL_GetError());
+        return 1;
+    }
+    if (started < threads) {
+        SDL_Log("Started %d of %d worker threads", started, threads);
+        threads = started;
+    }
+
+    fprintf(out, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+            tc_state.out_w, tc_state.out_h, video->fps_num, video->fps_den);
+
+    // read in order, write in order, workers process anything in between.
+    // a slot can only be read into once its previous frame was written so
+    // the slot ring doubles as the reorder buffer
+    Uint64 start = SDL_GetTicksNS();
+    Uint64 read_seq = 0;
+    Uint64 write_seq = 0;
+    bool eof = false;
+    bool failed = false;
+    SDL_LockMutex(tc_state.lock);
+    while (!eof || write_seq < read_seq) {
+        Slot *next_out = &tc_state.slots[write_seq % tc_state.slot_count];
+        Slot *next_in = &tc_state.slots[read_seq % tc_state.slot_count];
+        if (write_seq < read_seq && next_out->state == SLOT_DONE) {
+            SDL_UnlockMutex(tc_state.lock);
+            Uint64 t = trace_begin();
+            bool ok = write_slot(out, next_out);
+            trace_end("write", t);
+            SDL_LockMutex(tc_state.lock);
+            if (!ok) {
+                ERROR("Failed to write frame %llu", (unsigned long long)write_seq);
+                failed = true;
+                break;
+            }
+            next_out->state = SLOT_FREE;
+            write_seq++;
+        } else if (!eof && next_in->state == SLOT_FREE) {
+            SDL_UnlockMutex(tc_state.lock);
+            Uint64 t = trace_begin();
+            bool ok = read_frame(video, next_in->in);
+            trace_end("read", t);
+            SDL_LockMutex(tc_state.lock);
+            if (ok) {
+                next_in->state = SLOT_QUEUED;
+                read_seq++;
+                SDL_SignalCondition(tc_state.work_cond);
+            } else {
+                eof = true;
+            }
+        } else {
+            SDL_WaitCondition(tc_state.done_cond, tc_state.lock);
+        }
+    }
+    tc_state.quit = true;
+    SDL_BroadcastCondition(tc_state.work_cond);
+    SDL_UnlockMutex(tc_state.lock);
+
+    for (int i = 0; i < threads; i++) {
+        SDL_WaitThread(workers[i], NULL);
+    }
+    fflush(out);
+
+    double seconds = (SDL_GetTicksNS() - start) / 1e9;
+    double fps = seconds > 0.0 ? write_seq / seconds : 0.0;
+    SDL_Log("transcoded %llu frames %dx%d -> %dx%d cells -> %dx%d in %.2fs",
+            (unsigned long long)write_seq, video->w, video->h, cols, rows,
+            tc_state.out_w, tc_state.out_h, seconds);
+    SDL_Log("%.2f fps, %.2f fps per thread (%d threads)", fps, fps / threads, threads);
+
+    // cleanup
+    for (int i = 0; i < tc_state.slot_count; i++) {
+        Slot *slot = &tc_state.slots[i];
+        free(slot->in);
+        free(slot->yuv);
+        SDL_DestroySurface(slot->frame);
+        SDL_DestroySurface(slot->out);
+        ascii_grid_free(&slot->grid);
+    }
+    free(tc_state.slots);
+    free(workers);
+    free(tc_state.x_map);
+    free(tc_state.y_map);
+    SDL_DestroyCondition(tc_state.work_cond);
+    SDL_DestroyCondition(tc_state.done_cond);
+    SDL_DestroyMutex(tc_state.lock);
+    if (video->file != stdin) fclose(video->file);
+    if (out != stdout) fclose(out);
+    ascii_destroy(tc_state.ascii);
+    trace_stop();
+    SDL_Quit();
+
+    return failed ? 1 : 0;
+}
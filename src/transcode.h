@@ -0,0 +1,11 @@
+#ifndef TRANSCODE_H
+#define TRANSCODE_H
+
+/* Offline mode: j-ascii transcode [options] <in> <out>
+   reads a Y4M or raw RGB24 video, renders every frame with the ascii
+   renderer on all cores and writes Y4M in the input order.
+   argv starts after the "transcode" argument.
+*/
+int transcode_main(int argc, char *argv[]);
+
+#endif